@@ -95,6 +95,12 @@ Intersection AABB::intersect(const Ray& ray) const {
 	return Intersection(t_result, normal);
 }
 
+// Only finds where the ray enters the box, for tree traversal.
+// Fails if the box is behind the ray or entered after maxDistance.
+bool AABB::intersectInterval(const Ray& ray, float maxDistance, float& entryDistance) const {
+	return intersectInterval(min, max, ray, maxDistance, entryDistance);
+}
+
 bool AABB::contains(const Shape& obj) const {
 	return obj.isInside(*this);
 }
@@ -161,4 +167,22 @@ void AABB::expand(const Shape& obj) {
 	if (obj.getMaxX() > max.x) { max.x = obj.getMaxX(); }
 	if (obj.getMaxY() > max.y) { max.y = obj.getMaxY(); }
 	if (obj.getMaxZ() > max.z) { max.z = obj.getMaxZ(); }
-}
\ No newline at end of file
+}
+
+void AABB::expand(const AABB& box) {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+void AABB::expand(const glm::vec3& point) {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+float AABB::getSurfaceArea() const {
+	glm::vec3 extent = max - min;
+	if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+		return 0.0f;
+	}
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
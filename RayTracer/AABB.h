@@ -1,28 +1,34 @@
 #pragma once
 #include "Shape.h"
 
-class AABB :
-	public Shape
+//Bounds of shapes and tree nodes. Not a Shape itself, so it has no normal or
+//material and no virtual calls.
+class AABB
 {
 	public:
 		AABB(const glm::vec3& min, const glm::vec3& max);
 		AABB();
-		virtual ~AABB();
-		virtual float getMinX() const override;
-		virtual float getMinY() const override;
-		virtual float getMinZ() const override;
-		virtual float getMaxX() const override;
-		virtual float getMaxY() const override;
-		virtual float getMaxZ() const override;
+		~AABB();
+		float getMinX() const;
+		float getMinY() const;
+		float getMinZ() const;
+		float getMaxX() const;
+		float getMaxY() const;
+		float getMaxZ() const;
 		glm::vec3 getMin() const;
 		glm::vec3 getMax() const;
-		virtual Intersection intersect(const Ray& ray) const override;
+		Intersection intersect(const Ray& ray) const;
+		bool intersectInterval(const Ray& ray, float maxDistance, float& entryDistance) const;
+		static bool intersectInterval(const glm::vec3& min, const glm::vec3& max, const Ray& ray, float maxDistance, float& entryDistance);
 		bool contains(const Shape& obj) const;
 		bool contains(const glm::vec3& point) const;
 		glm::vec3 getMidPoint() const;
 		AABB splitLeft() const;
 		AABB splitRight() const;
 		void expand(const Shape& obj);
+		void expand(const AABB& box);
+		void expand(const glm::vec3& point);
+		float getSurfaceArea() const;
 
 	private:
 		enum class Axis {
@@ -36,3 +42,18 @@ class AABB :
 		Axis getLongestAxis() const;
 };
 
+// Slab test used at every tree node, so it's inline and only works out the
+// interval. The ray's sign picks the near and far plane on each axis instead
+// of sorting the plane distances.
+inline bool AABB::intersectInterval(const glm::vec3& min, const glm::vec3& max, const Ray& ray, float maxDistance, float& entryDistance) {
+	float nearX = ((ray.sign[0] ? max.x : min.x) - ray.origin.x) * ray.invDir.x;
+	float farX = ((ray.sign[0] ? min.x : max.x) - ray.origin.x) * ray.invDir.x;
+	float nearY = ((ray.sign[1] ? max.y : min.y) - ray.origin.y) * ray.invDir.y;
+	float farY = ((ray.sign[1] ? min.y : max.y) - ray.origin.y) * ray.invDir.y;
+	float nearZ = ((ray.sign[2] ? max.z : min.z) - ray.origin.z) * ray.invDir.z;
+	float farZ = ((ray.sign[2] ? min.z : max.z) - ray.origin.z) * ray.invDir.z;
+	entryDistance = std::max(std::max(nearX, nearY), std::max(nearZ, 0.0f));
+	float exitDistance = std::min(std::min(farX, farY), std::min(farZ, maxDistance));
+	return entryDistance <= exitDistance;
+}
+
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <limits>
+#include "SceneObjects.hpp"
+#include "RenderStats.h"
+
+//Common interface for the trees Scene can use to find ray intersections
+class AccelerationStructure{
+	public:
+		virtual ~AccelerationStructure() {}
+		//Both queries add the work they do to stats
+		//Closest hit nearer than maxDistance along the ray
+		virtual Intersection findClosestIntersection(const Ray& ray, float maxDistance, TraversalStats& stats) const = 0;
+		//True if anything is hit closer than maxDistance along the ray
+		virtual bool isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const = 0;
+		//Packets of up to maxPacketSize rays that are queried together. These
+		//trace the rays one at a time, trees that can share work between
+		//the rays of a packet override them.
+		static const int maxPacketSize = 64;
+		//closest must have room for one result per ray
+		virtual void findClosestIntersections(const std::vector<Ray>& rays, Intersection* closest, TraversalStats& stats) const {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				closest[i] = findClosestIntersection(rays[i], std::numeric_limits<float>::infinity(), stats);
+			}
+		}
+		//occluded[i] is set if rays[i] hits anything closer than maxDistances[i]
+		virtual void findOccluded(const std::vector<Ray>& rays, const float* maxDistances, bool* occluded, TraversalStats& stats) const {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				occluded[i] = isOccluded(rays[i], maxDistances[i], stats);
+			}
+		}
+};
@@ -0,0 +1,191 @@
+#include "BVH.h"
+#include <algorithm>
+#include <limits>
+#include "TaskScheduler.h"
+
+BVH::BVH(const Primitives& primitives) : LinearTree(primitives) {
+	std::vector<ObjectInfo> info(primitives.getNumObjects());
+	TaskScheduler::get().parallelFor(0, info.size(), parallelBinSize, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			info[i] = ObjectInfo(i, primitives.getObject(i));
+		}
+	});
+	if (!info.empty()) {
+		Bin bounds = computeBounds(info);
+		BuildNode root{ AABB(bounds.min, bounds.max), 0, static_cast<int>(info.size()) };
+		build(info, root, AABB(bounds.centroidMin, bounds.centroidMax), 0);
+		flatten(info, root, allocateNodes(1));
+	}
+}
+
+BVH::~BVH() {
+}
+
+void BVH::Bin::add(const ObjectInfo& object) {
+	min = glm::min(min, object.min);
+	max = glm::max(max, object.max);
+	centroidMin = glm::min(centroidMin, object.centroid);
+	centroidMax = glm::max(centroidMax, object.centroid);
+	count++;
+}
+
+void BVH::Bin::add(const Bin& other) {
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+	centroidMin = glm::min(centroidMin, other.centroidMin);
+	centroidMax = glm::max(centroidMax, other.centroidMax);
+	count += other.count;
+}
+
+float BVH::Bin::getSurfaceArea() const {
+	glm::vec3 extent = max - min;
+	if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+		return 0.0f;
+	}
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+BVH::Binning::Binning(const AABB& centroidBox) : min(centroidBox.getMin()) {
+	glm::vec3 extent = centroidBox.getMax() - min;
+	for (int axis = 0; axis < 3; ++axis) {
+		scale[axis] = extent[axis] > 0.0f ? binCount / extent[axis] : 0.0f;
+	}
+}
+
+BVH::Bin BVH::computeBounds(const std::vector<ObjectInfo>& info) const {
+	size_t pieceCount = (info.size() + parallelBinSize - 1) / parallelBinSize;
+	std::vector<Bin> pieces(pieceCount);
+	TaskScheduler::get().parallelFor(0, pieceCount, 1, [&](size_t firstPiece, size_t lastPiece) {
+		for (size_t piece = firstPiece; piece < lastPiece; ++piece) {
+			size_t last = std::min(info.size(), (piece + 1) * parallelBinSize);
+			for (size_t i = piece * parallelBinSize; i < last; ++i) {
+				pieces[piece].add(info[i]);
+			}
+		}
+	});
+	Bin bounds;
+	for (const Bin& piece : pieces) {
+		bounds.add(piece);
+	}
+	return bounds;
+}
+
+void BVH::computeBins(const std::vector<ObjectInfo>& info, int start, int end, const Binning& binning, Bins& bins) const {
+	auto binObjects = [&](int first, int last, Bins& into) {
+		for (int i = first; i < last; ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				into[axis * binCount + binning.getBin(info[i], axis)].add(info[i]);
+			}
+		}
+	};
+	int count = end - start;
+	if (count <= parallelBinSize) {
+		binObjects(start, end, bins);
+		return;
+	}
+	int pieceCount = (count + parallelBinSize - 1) / parallelBinSize;
+	std::vector<Bins> pieces(pieceCount);
+	TaskScheduler::get().parallelFor(0, pieceCount, 1, [&](size_t firstPiece, size_t lastPiece) {
+		for (size_t piece = firstPiece; piece < lastPiece; ++piece) {
+			int first = start + piece * parallelBinSize;
+			binObjects(first, std::min(end, first + parallelBinSize), pieces[piece]);
+		}
+	});
+	for (const Bins& piece : pieces) {
+		for (int i = 0; i < 3 * binCount; ++i) {
+			bins[i].add(piece[i]);
+		}
+	}
+}
+
+// Tries a split between every pair of neighbouring bins on every axis and
+// keeps the cheapest. Costs are all scaled by the surface area of the node so
+// a flat node can't cause a division by zero.
+BVH::Split BVH::findSplit(const std::vector<ObjectInfo>& info, const BuildNode& node, const Binning& binning) const {
+	Split best;
+	int count = node.end - node.start;
+	if (count <= 1) {
+		return best;
+	}
+	Bins bins;
+	computeBins(info, node.start, node.end, binning, bins);
+	float area = node.box.getSurfaceArea();
+	for (int axis = 0; axis < 3; ++axis) {
+		if (binning.scale[axis] == 0.0f) {
+			continue;
+		}
+		const Bin* axisBins = &bins[axis * binCount];
+		float rightAreas[binCount];
+		int rightCounts[binCount];
+		// Small nodes leave most bins empty. Splitting next to an empty bin
+		// costs the same as the split before it, so those are skipped.
+		Bin right;
+		float rightArea = 0.0f;
+		for (int i = binCount - 1; i > 0; --i) {
+			if (axisBins[i].count > 0) {
+				right.add(axisBins[i]);
+				rightArea = right.getSurfaceArea();
+			}
+			rightAreas[i] = rightArea;
+			rightCounts[i] = right.count;
+		}
+		Bin left;
+		for (int i = 1; i < binCount; ++i) {
+			if (axisBins[i - 1].count == 0) {
+				continue;
+			}
+			left.add(axisBins[i - 1]);
+			if (rightCounts[i] == 0) {
+				break;
+			}
+			float cost = traversalCost * area + intersectionCost * (left.getSurfaceArea() * left.count + rightAreas[i] * rightCounts[i]);
+			if (cost < best.cost) {
+				best.cost = cost;
+				best.axis = axis;
+				best.bin = i;
+			}
+		}
+	}
+	if (best.axis != -1) {
+		for (int i = 0; i < binCount; ++i) {
+			(i < best.bin ? best.left : best.right).add(bins[best.axis * binCount + i]);
+		}
+	}
+	return best;
+}
+
+void BVH::build(std::vector<ObjectInfo>& info, BuildNode& node, const AABB& centroidBox, int depth) {
+	int count = node.end - node.start;
+	Binning binning(centroidBox);
+	Split split = findSplit(info, node, binning);
+
+	// Objects whose centroids all coincide can't be separated, otherwise
+	// only make a leaf when it is cheap and small enough or the tree is too deep
+	float leafCost = intersectionCost * count * node.box.getSurfaceArea();
+	if (split.axis == -1 || depth >= maxDepth || (count <= maxObjectsPerLeaf && split.cost >= leafCost)) {
+		return;
+	}
+
+	std::vector<ObjectInfo>::iterator middle = std::partition(info.begin() + node.start, info.begin() + node.end, [&](const ObjectInfo& object) {
+		return binning.getBin(object, split.axis) < split.bin;
+	});
+	int firstRight = middle - info.begin();
+	node.left.reset(new BuildNode{ AABB(split.left.min, split.left.max), node.start, firstRight });
+	node.right.reset(new BuildNode{ AABB(split.right.min, split.right.max), firstRight, node.end });
+	AABB leftCentroids(split.left.centroidMin, split.left.centroidMax);
+	AABB rightCentroids(split.right.centroidMin, split.right.centroidMax);
+	//The children only touch their own objects, so big ones are built on
+	//other threads
+	if (count >= parallelBuildSize) {
+		TaskScheduler::TaskGroup children;
+		children.run([&]() {
+			build(info, *node.left, leftCentroids, depth + 1);
+		});
+		build(info, *node.right, rightCentroids, depth + 1);
+		children.wait();
+	}
+	else {
+		build(info, *node.left, leftCentroids, depth + 1);
+		build(info, *node.right, rightCentroids, depth + 1);
+	}
+}
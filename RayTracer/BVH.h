@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include "SceneObjects.hpp"
+#include "Shape.h"
+#include "AABB.h"
+#include "LinearTree.h"
+
+//Bounding volume hierarchy built with the surface area heuristic.
+//Unlike Partition every object is stored in exactly one leaf. Splits are
+//only tried between bins of object centroids, and large subtrees are built
+//on the TaskScheduler before the tree is flattened on one thread.
+class BVH : public LinearTree{
+	public:
+		BVH(const Primitives& primitives);
+		virtual ~BVH();
+
+	private:
+		//Costs are relative to a single object intersection test
+		float traversalCost = 0.125f;
+		float intersectionCost = 1.0f;
+		int maxObjectsPerLeaf = 8;
+		static const int binCount = 32;
+		//Nodes with at least this many objects build their children in parallel
+		int parallelBuildSize = 1024;
+		//Nodes with more objects than this are binned in pieces this big on
+		//separate threads
+		int parallelBinSize = 16384;
+		struct ObjectInfo {
+			uint32_t index;
+			glm::vec3 min;
+			glm::vec3 max;
+			glm::vec3 centroid;
+			ObjectInfo() {}
+			ObjectInfo(uint32_t index, const Shape& object) : index(index) {
+				min = glm::vec3(object.getMinX(), object.getMinY(), object.getMinZ());
+				max = glm::vec3(object.getMaxX(), object.getMaxY(), object.getMaxZ());
+				centroid = (min + max) / 2.0f;
+			}
+		};
+		//Bounds of some objects and of their centroids. Plain vectors rather
+		//than AABBs since bins are merged millions of times in a build.
+		struct Bin {
+			glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+			glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+			glm::vec3 centroidMin = glm::vec3(std::numeric_limits<float>::infinity());
+			glm::vec3 centroidMax = glm::vec3(-std::numeric_limits<float>::infinity());
+			int count = 0;
+			void add(const ObjectInfo& object);
+			void add(const Bin& other);
+			//Same as AABB::getSurfaceArea of the bounds
+			float getSurfaceArea() const;
+		};
+		//Places centroids in binCount bins spread evenly over a node's
+		//centroid bounds on each axis. Flat axes put everything in bin 0.
+		struct Binning {
+			glm::vec3 min;
+			glm::vec3 scale;
+			Binning(const AABB& centroidBox);
+			int getBin(const ObjectInfo& object, int axis) const {
+				int bin = static_cast<int>((object.centroid[axis] - min[axis]) * scale[axis]);
+				return std::min(std::max(bin, 0), binCount - 1);
+			}
+		};
+		//binCount bins along each axis, x first
+		typedef std::array<Bin, 3 * binCount> Bins;
+		//Cheapest split found for a node: objects in bins below bin on axis go
+		//to the left child. axis is -1 when the objects can't be split.
+		struct Split {
+			int axis = -1;
+			int bin = 0;
+			float cost = std::numeric_limits<float>::infinity();
+			Bin left;
+			Bin right;
+		};
+		void computeBins(const std::vector<ObjectInfo>& info, int start, int end, const Binning& binning, Bins& bins) const;
+		Bin computeBounds(const std::vector<ObjectInfo>& info) const;
+		//Bins are kept out of build's stack frame since it recurses
+		Split findSplit(const std::vector<ObjectInfo>& info, const BuildNode& node, const Binning& binning) const;
+		void build(std::vector<ObjectInfo>& info, BuildNode& node, const AABB& centroidBox, int depth);
+};
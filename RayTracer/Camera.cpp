@@ -20,7 +20,7 @@ Ray Camera::createRayToPixel(float i, float j, int width, int height) const {
 	float beta = glm::tan(glm::radians(fovy / 2.0f)) * (((height / 2.0f) - j) / (height / 2.0f));
 	glm::vec3 rayDir = (alpha * u) + (beta * v) - w;
 
-	return Ray(lookFrom, rayDir);
+	return Ray(lookFrom, glm::normalize(rayDir));
 }
 
 glm::vec3 Camera::createPointFromRay(const Ray& ray, float t) {
@@ -44,4 +44,8 @@ Color Color::operator*(float x) const {
 
 Color Color::operator*(const Color& other) const {
 	return Color(r * other.r, g * other.g, b * other.b);
-}
\ No newline at end of file
+}
+
+bool Color::operator==(const Color& other) const {
+	return r == other.r && g == other.g && b == other.b;
+}
@@ -14,6 +14,7 @@ class Color
 		glm::vec3 getAsFloat() const;
 		Color operator*(float x) const;
 		Color operator*(const Color& other) const;
+		bool operator==(const Color& other) const;
 
 	private:
 		float r, g, b;
@@ -0,0 +1,62 @@
+#include "CpuFeatures.h"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define RAYTRACER_X86
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define RAYTRACER_X86
+#endif
+
+#ifdef RAYTRACER_X86
+namespace {
+	void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuidex(info, leaf, subleaf);
+		for (int i = 0; i < 4; ++i) {
+			regs[i] = info[i];
+		}
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	unsigned long long xgetbv() {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+}
+#endif
+
+CpuFeatures::CpuFeatures() {
+#ifdef RAYTRACER_X86
+	unsigned int regs[4];
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+	cpuid(1, 0, regs);
+	sse2 = (regs[3] & (1u << 26)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	// The OS has to have enabled saving the SSE and AVX registers, and for
+	// AVX-512 the mask registers and upper halves of the 512 bit ones
+	unsigned long long savedState = osxsave ? xgetbv() : 0;
+	bool osSavesYmm = (savedState & 0x6) == 0x6;
+	bool osSavesZmm = (savedState & 0xE6) == 0xE6;
+	if (maxLeaf >= 7 && avx && osSavesYmm) {
+		cpuid(7, 0, regs);
+		avx2 = (regs[1] & (1u << 5)) != 0;
+		avx512 = osSavesZmm && (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 31)) != 0;
+	}
+#endif
+}
+
+const CpuFeatures& CpuFeatures::get() {
+	static const CpuFeatures features;
+	return features;
+}
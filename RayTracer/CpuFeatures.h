@@ -0,0 +1,16 @@
+#pragma once
+
+//Instruction sets the machine running the program supports, read once with
+//cpuid. Lets one build pick faster kernels on newer CPUs at runtime.
+struct CpuFeatures {
+	bool sse2 = false;
+	//Also requires the OS to save the wider registers on context switches
+	bool avx2 = false;
+	//AVX-512F with the 128 and 256 bit forms (VL), and the OS saving the
+	//mask and 512 bit registers
+	bool avx512 = false;
+	static const CpuFeatures& get();
+
+	private:
+		CpuFeatures();
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "TriangleMesh.h"
+#include "Primitives.h"
+#include "AccelerationStructure.h"
+
+//Triangles placed in the scene more than once. Stored in object space with a
+//tree of their own, built once and shared by every MeshInstance of them.
+//Never moved once made, since primitives and tree refer to mesh.
+struct InstancedMesh {
+	TriangleMesh mesh;
+	//Only mesh's triangles
+	Primitives primitives;
+	std::unique_ptr<AccelerationStructure> tree;
+	InstancedMesh(uint32_t materialIndex) : mesh(materialIndex) {}
+};
@@ -0,0 +1,169 @@
+#include "LBVH.h"
+#include <algorithm>
+#include "TaskScheduler.h"
+
+namespace {
+	//Spreads the low 21 bits of value out to every third bit
+	uint64_t spreadBits(uint64_t value) {
+		value &= 0x1fffff;
+		value = (value | value << 32) & 0x1f00000000ffffull;
+		value = (value | value << 16) & 0x1f0000ff0000ffull;
+		value = (value | value << 8) & 0x100f00f00f00f00full;
+		value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+		value = (value | value << 2) & 0x1249249249249249ull;
+		return value;
+	}
+
+	//Only the highest set bit of value
+	uint64_t getHighestBit(uint64_t value) {
+		value |= value >> 1;
+		value |= value >> 2;
+		value |= value >> 4;
+		value |= value >> 8;
+		value |= value >> 16;
+		value |= value >> 32;
+		return value ^ (value >> 1);
+	}
+}
+
+LBVH::LBVH(const Primitives& primitives) : LinearTree(primitives) {
+	TaskScheduler& scheduler = TaskScheduler::get();
+	uint32_t numObjects = primitives.getNumObjects();
+	if (numObjects == 0) {
+		return;
+	}
+	std::vector<AABB> bounds(numObjects);
+	std::vector<glm::vec3> centroids(numObjects);
+	scheduler.parallelFor(0, numObjects, parallelSortSize, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			const Shape& object = primitives.getObject(i);
+			glm::vec3 min(object.getMinX(), object.getMinY(), object.getMinZ());
+			glm::vec3 max(object.getMaxX(), object.getMaxY(), object.getMaxZ());
+			bounds[i] = AABB(min, max);
+			centroids[i] = (min + max) / 2.0f;
+		}
+	});
+	AABB centroidBox;
+	for (const glm::vec3& centroid : centroids) {
+		centroidBox.expand(centroid);
+	}
+	std::vector<MortonObject> objects(numObjects);
+	scheduler.parallelFor(0, numObjects, parallelSortSize, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			objects[i] = MortonObject{ getMortonCode(centroids[i], centroidBox), static_cast<uint32_t>(i) };
+		}
+	});
+	sortObjects(objects);
+	BuildNode root{ AABB(), 0, static_cast<int>(numObjects) };
+	build(objects, bounds, root, 0);
+	flatten(objects, root, allocateNodes(1));
+}
+
+LBVH::~LBVH() {
+}
+
+uint64_t LBVH::getMortonCode(const glm::vec3& centroid, const AABB& centroidBox) {
+	const float cells = static_cast<float>(1 << mortonBits);
+	glm::vec3 extent = centroidBox.getMax() - centroidBox.getMin();
+	uint64_t code = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		float position = extent[axis] > 0.0f ? (centroid[axis] - centroidBox.getMin()[axis]) / extent[axis] : 0.0f;
+		uint64_t cell = static_cast<uint64_t>(std::min(std::max(position * cells, 0.0f), cells - 1.0f));
+		code |= spreadBits(cell) << (2 - axis);
+	}
+	return code;
+}
+
+// Each pass counts the digits of every piece of objects, works out where each
+// piece's objects with each digit go, then has every piece move its objects
+// there. Pieces keep their order, so every pass is stable.
+void LBVH::sortObjects(std::vector<MortonObject>& objects) const {
+	const int digitBits = 8;
+	const int digitCount = 1 << digitBits;
+	size_t numObjects = objects.size();
+	size_t pieceCount = (numObjects + parallelSortSize - 1) / parallelSortSize;
+	std::vector<MortonObject> sorted(numObjects);
+	std::vector<size_t> offsets(pieceCount * digitCount);
+	TaskScheduler& scheduler = TaskScheduler::get();
+	auto forEachPiece = [&](const std::function<void(size_t piece, size_t first, size_t last)>& body) {
+		scheduler.parallelFor(0, pieceCount, 1, [&](size_t firstPiece, size_t lastPiece) {
+			for (size_t piece = firstPiece; piece < lastPiece; ++piece) {
+				body(piece, piece * parallelSortSize, std::min(numObjects, (piece + 1) * parallelSortSize));
+			}
+		});
+	};
+	for (int shift = 0; shift < 3 * mortonBits; shift += digitBits) {
+		std::fill(offsets.begin(), offsets.end(), 0);
+		forEachPiece([&](size_t piece, size_t first, size_t last) {
+			size_t* counts = &offsets[piece * digitCount];
+			for (size_t i = first; i < last; ++i) {
+				counts[(objects[i].code >> shift) & (digitCount - 1)]++;
+			}
+		});
+		//Passes where every code has the same digit wouldn't move anything
+		size_t sameDigit = 0;
+		for (int digit = 0; digit < digitCount; ++digit) {
+			size_t total = 0;
+			for (size_t piece = 0; piece < pieceCount; ++piece) {
+				total += offsets[piece * digitCount + digit];
+			}
+			sameDigit = std::max(sameDigit, total);
+		}
+		if (sameDigit == numObjects) {
+			continue;
+		}
+		size_t position = 0;
+		for (int digit = 0; digit < digitCount; ++digit) {
+			for (size_t piece = 0; piece < pieceCount; ++piece) {
+				size_t count = offsets[piece * digitCount + digit];
+				offsets[piece * digitCount + digit] = position;
+				position += count;
+			}
+		}
+		forEachPiece([&](size_t piece, size_t first, size_t last) {
+			size_t* next = &offsets[piece * digitCount];
+			for (size_t i = first; i < last; ++i) {
+				sorted[next[(objects[i].code >> shift) & (digitCount - 1)]++] = objects[i];
+			}
+		});
+		objects.swap(sorted);
+	}
+}
+
+// Sorted codes that share their highest bits are next to each other, so a
+// range is split where the highest bit that differs between its first and
+// last code turns on. Ranges of equal codes are split in the middle.
+void LBVH::build(const std::vector<MortonObject>& objects, const std::vector<AABB>& bounds, BuildNode& node, int depth) {
+	int count = node.end - node.start;
+	if (count <= maxObjectsPerLeaf || depth >= maxDepth) {
+		for (int i = node.start; i < node.end; ++i) {
+			node.box.expand(bounds[objects[i].index]);
+		}
+		return;
+	}
+	uint64_t differentBits = objects[node.start].code ^ objects[node.end - 1].code;
+	int split = node.start + count / 2;
+	if (differentBits != 0) {
+		uint64_t splitBit = getHighestBit(differentBits);
+		std::vector<MortonObject>::const_iterator firstRight = std::partition_point(objects.begin() + node.start, objects.begin() + node.end, [splitBit](const MortonObject& object) {
+			return (object.code & splitBit) == 0;
+		});
+		split = firstRight - objects.begin();
+	}
+	node.left.reset(new BuildNode{ AABB(), node.start, split });
+	node.right.reset(new BuildNode{ AABB(), split, node.end });
+	if (count >= parallelBuildSize) {
+		TaskScheduler::TaskGroup children;
+		children.run([&]() {
+			build(objects, bounds, *node.left, depth + 1);
+		});
+		build(objects, bounds, *node.right, depth + 1);
+		children.wait();
+	}
+	else {
+		build(objects, bounds, *node.left, depth + 1);
+		build(objects, bounds, *node.right, depth + 1);
+	}
+	node.box.expand(node.left->box);
+	node.box.expand(node.right->box);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "SceneObjects.hpp"
+#include "Shape.h"
+#include "AABB.h"
+#include "LinearTree.h"
+
+//Linear bounding volume hierarchy. Objects are sorted along a Morton curve
+//through their centroids and every range of the sorted objects is split
+//where the highest bit of the codes changes. Builds far faster than BVH, but
+//the splits ignore object sizes so the tree is slower to trace. Meant for
+//previews and scenes that are rebuilt often.
+class LBVH : public LinearTree{
+	public:
+		LBVH(const Primitives& primitives);
+		virtual ~LBVH();
+
+	private:
+		//Ranges this small become leaves
+		int maxObjectsPerLeaf = 4;
+		//Ranges with at least this many objects build their halves in parallel
+		int parallelBuildSize = 1024;
+		//Objects are sorted in pieces this big on separate threads
+		int parallelSortSize = 16384;
+		//Bits per axis in a Morton code, 63 bits in all
+		static const int mortonBits = 21;
+		struct MortonObject {
+			uint64_t code;
+			uint32_t index;
+		};
+		static uint64_t getMortonCode(const glm::vec3& centroid, const AABB& centroidBox);
+		//Least significant digit first radix sort on the codes, 8 bits at a time
+		void sortObjects(std::vector<MortonObject>& objects) const;
+		void build(const std::vector<MortonObject>& objects, const std::vector<AABB>& bounds, BuildNode& node, int depth);
+};
@@ -0,0 +1,352 @@
+#include "LinearTree.h"
+
+LinearTree::LinearTree(const Primitives& primitives) : primitives(primitives), triangleKernel(SimdKernels::get().intersectTriangles), sphereKernel(SimdKernels::get().intersectSpheres) {
+}
+
+LinearTree::~LinearTree() {
+}
+
+int LinearTree::getNumNodes() const {
+	return nodes.size();
+}
+
+uint32_t LinearTree::allocateNodes(int numNodes) {
+	uint32_t first = nodes.size();
+	nodes.resize(nodes.size() + numNodes);
+	return first;
+}
+
+//Leaves must hold at least one object, builders drop empty subtrees
+void LinearTree::setLeaf(uint32_t nodeIndex, const AABB& box, const std::vector<uint32_t>& leafObjects) {
+	LinearNode& node = nodes[nodeIndex];
+	node.min = box.getMin();
+	node.max = box.getMax();
+	node.offset = leaves.size();
+	node.count = leafObjects.size();
+	Leaf leaf{ static_cast<uint32_t>(triangleIndices.size()), 0, static_cast<uint32_t>(sphereIndices.size()), 0, static_cast<uint32_t>(triangleBlocks.size()), static_cast<uint32_t>(sphereBlocks.size()), 0, static_cast<uint32_t>(instanceIndices.size()), 0 };
+	std::vector<uint32_t> blockSpheres;
+	for (uint32_t objectIndex : leafObjects) {
+		if (objectIndex < primitives.triangles.size()) {
+			triangleIndices.push_back(objectIndex);
+			leaf.triangleCount++;
+			continue;
+		}
+		if (primitives.isInstance(objectIndex)) {
+			instanceIndices.push_back(objectIndex - primitives.getInstanceObjectIndex(0));
+			leaf.instanceCount++;
+			continue;
+		}
+		uint32_t sphere = objectIndex - primitives.triangles.size();
+		if (sphereKernel != nullptr && primitives.spheres[sphere].isWorldSpace()) {
+			blockSpheres.push_back(sphere);
+		}
+		else {
+			sphereIndices.push_back(sphere);
+			leaf.sphereCount++;
+		}
+	}
+	if (triangleKernel != nullptr) {
+		addTriangleBlocks(leaf);
+	}
+	addSphereBlocks(leaf, blockSpheres);
+	leaves.push_back(leaf);
+}
+
+void LinearTree::addTriangleBlocks(Leaf& leaf) {
+	for (uint32_t first = 0; first < leaf.triangleCount; first += TriangleBlock::width) {
+		TriangleBlock block;
+		uint32_t count = std::min<uint32_t>(TriangleBlock::width, leaf.triangleCount - first);
+		block.laneMask = (1 << count) - 1;
+		for (uint32_t lane = 0; lane < static_cast<uint32_t>(TriangleBlock::width); ++lane) {
+			uint32_t triangle = triangleIndices[leaf.firstTriangle + first + std::min(lane, count - 1)];
+			block.triangles[lane] = triangle;
+			for (int corner = 0; corner < 3; ++corner) {
+				glm::vec3 vertex = primitives.triangles[triangle].getVertex(corner);
+				for (int axis = 0; axis < 3; ++axis) {
+					block.vertices[3 * corner + axis][lane] = vertex[axis];
+				}
+			}
+		}
+		triangleBlocks.push_back(block);
+	}
+}
+
+void LinearTree::addSphereBlocks(Leaf& leaf, const std::vector<uint32_t>& spheres) {
+	for (size_t first = 0; first < spheres.size(); first += SphereBlock::width) {
+		SphereBlock block;
+		size_t count = std::min<size_t>(SphereBlock::width, spheres.size() - first);
+		block.laneMask = (1 << count) - 1;
+		for (size_t lane = 0; lane < static_cast<size_t>(SphereBlock::width); ++lane) {
+			uint32_t sphere = spheres[first + std::min(lane, count - 1)];
+			glm::vec3 center = primitives.spheres[sphere].getWorldCenter();
+			for (int axis = 0; axis < 3; ++axis) {
+				block.centers[axis][lane] = center[axis];
+			}
+			block.radii[lane] = primitives.spheres[sphere].getWorldRadius();
+			block.objects[lane] = primitives.getSphereObjectIndex(sphere);
+		}
+		sphereBlocks.push_back(block);
+		leaf.sphereBlockCount++;
+	}
+}
+
+void LinearTree::setInterior(uint32_t nodeIndex, const AABB& box, uint32_t firstChild) {
+	LinearNode& node = nodes[nodeIndex];
+	node.min = box.getMin();
+	node.max = box.getMax();
+	node.offset = firstChild;
+	node.count = 0;
+}
+
+// Visits nodes front to back. The closest hit so far limits how far along the
+// ray a node can be entered, so once something is hit any node entered
+// further away is skipped without testing its contents.
+Intersection LinearTree::findClosestIntersection(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	Intersection closest(maxDistance);
+	float entryDistance;
+	if (nodes.empty() || !intersectBox(nodes[0], ray, closest.distAlongRay, entryDistance, stats)) {
+		return Intersection();
+	}
+	Mailbox mailbox;
+	Mailbox* leafMailbox = hasDuplicateObjects ? &mailbox : nullptr;
+	StackEntry stack[2 * maxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = StackEntry{ 0, entryDistance };
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		if (entry.entryDistance > closest.distAlongRay) {
+			continue;
+		}
+		const LinearNode& node = nodes[entry.nodeIndex];
+		stats.nodesVisited++;
+		if (node.isLeaf()) {
+			Intersection leafIntersect = intersectLeaf(node.offset, ray, closest.distAlongRay, stats, leafMailbox);
+			if (leafIntersect.isValidIntersection() && leafIntersect.distAlongRay < closest.distAlongRay) {
+				closest = leafIntersect;
+			}
+			continue;
+		}
+		float leftEntry, rightEntry;
+		bool hitLeft = intersectBox(nodes[node.offset], ray, closest.distAlongRay, leftEntry, stats);
+		bool hitRight = intersectBox(nodes[node.offset + 1], ray, closest.distAlongRay, rightEntry, stats);
+		if (hitLeft && hitRight) {
+			// Push the far child first so the near one is visited next
+			if (leftEntry <= rightEntry) {
+				stack[stackSize++] = StackEntry{ node.offset + 1, rightEntry };
+				stack[stackSize++] = StackEntry{ node.offset, leftEntry };
+			}
+			else {
+				stack[stackSize++] = StackEntry{ node.offset, leftEntry };
+				stack[stackSize++] = StackEntry{ node.offset + 1, rightEntry };
+			}
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = StackEntry{ node.offset, leftEntry };
+		}
+		else if (hitRight) {
+			stack[stackSize++] = StackEntry{ node.offset + 1, rightEntry };
+		}
+	}
+	return closest.distAlongRay < maxDistance ? closest : Intersection();
+}
+
+// Any hit inside the interval answers the query, so there is no need to
+// order the children or find the closest object.
+bool LinearTree::isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	if (nodes.empty()) {
+		return false;
+	}
+	Mailbox mailbox;
+	Mailbox* leafMailbox = hasDuplicateObjects ? &mailbox : nullptr;
+	uint32_t stack[2 * maxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const LinearNode& node = nodes[stack[--stackSize]];
+		float entryDistance;
+		if (!intersectBox(node, ray, maxDistance, entryDistance, stats)) {
+			continue;
+		}
+		// Counted once entered, like findClosestIntersection
+		stats.nodesVisited++;
+		if (node.isLeaf()) {
+			if (isLeafOccluded(node.offset, ray, maxDistance, stats, leafMailbox)) {
+				return true;
+			}
+		}
+		else {
+			stack[stackSize++] = node.offset + 1;
+			stack[stackSize++] = node.offset;
+		}
+	}
+	return false;
+}
+
+bool LinearTree::intersectBox(const LinearNode& node, const Ray& ray, float maxDistance, float& entryDistance, TraversalStats& stats) const {
+	stats.boxTests++;
+	return AABB::intersectInterval(node.min, node.max, ray, maxDistance, entryDistance);
+}
+
+// One loop per type, so each calls that type's intersect directly. Triangles
+// and world space spheres are tested a block at a time when the CPU has the
+// kernels, otherwise one at a time. Objects are put in the mailbox by their
+// scene wide index.
+Intersection LinearTree::intersectLeaf(uint32_t leafIndex, const Ray& ray, float maxDistance, TraversalStats& stats, Mailbox* mailbox) const {
+	const Leaf& leaf = leaves[leafIndex];
+	Intersection closest(maxDistance);
+	uint32_t triangleCount = triangleKernel != nullptr ? 0 : leaf.triangleCount;
+	uint32_t blockCount = triangleKernel != nullptr ? (leaf.triangleCount + TriangleBlock::width - 1) / TriangleBlock::width : 0;
+	for (uint32_t i = leaf.firstTriangleBlock; i < leaf.firstTriangleBlock + blockCount; ++i) {
+		const TriangleBlock& block = triangleBlocks[i];
+		int laneMask = getUntestedLanes(block.triangles, block.laneMask, stats, mailbox);
+		TriangleBlock::Hits hits;
+		int edgeMask;
+		int hitMask = triangleKernel(block, ray, laneMask, closest.distAlongRay, hits, edgeMask);
+		// Lanes are checked in order so ties go to the same triangle as when
+		// testing one at a time
+		for (int lane = 0; lane < TriangleBlock::width; ++lane) {
+			if (edgeMask & (1 << lane)) {
+				Intersection currentIntersect = primitives.triangles[block.triangles[lane]].intersect(ray);
+				if (currentIntersect.distAlongRay < closest.distAlongRay) {
+					closest = currentIntersect;
+					closest.objectIndex = block.triangles[lane];
+				}
+			}
+			else if ((hitMask & (1 << lane)) && hits.distances[lane] < closest.distAlongRay) {
+				closest = Intersection(hits.distances[lane], glm::vec2(hits.v[lane], hits.w[lane]));
+				closest.objectIndex = block.triangles[lane];
+			}
+		}
+	}
+	for (uint32_t i = leaf.firstTriangle; i < leaf.firstTriangle + triangleCount; ++i) {
+		uint32_t triangle = triangleIndices[i];
+		// An object tested in an earlier leaf already had its hit compared
+		// against the closest one
+		if (mailbox != nullptr && mailbox->checkAndRecord(triangle)) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		stats.primitiveTests++;
+		Intersection currentIntersect = primitives.triangles[triangle].intersect(ray);
+		if (currentIntersect.distAlongRay < closest.distAlongRay) {
+			closest = currentIntersect;
+			closest.objectIndex = triangle;
+		}
+	}
+	for (uint32_t i = leaf.firstSphereBlock; i < leaf.firstSphereBlock + leaf.sphereBlockCount; ++i) {
+		const SphereBlock& block = sphereBlocks[i];
+		int laneMask = getUntestedLanes(block.objects, block.laneMask, stats, mailbox);
+		float distances[SphereBlock::width];
+		int hitMask = sphereKernel(block, ray, laneMask, closest.distAlongRay, distances);
+		for (int lane = 0; lane < SphereBlock::width; ++lane) {
+			if ((hitMask & (1 << lane)) && distances[lane] < closest.distAlongRay) {
+				closest = Intersection(distances[lane]);
+				closest.objectIndex = block.objects[lane];
+			}
+		}
+	}
+	for (uint32_t i = leaf.firstSphere; i < leaf.firstSphere + leaf.sphereCount; ++i) {
+		uint32_t objectIndex = primitives.getSphereObjectIndex(sphereIndices[i]);
+		if (mailbox != nullptr && mailbox->checkAndRecord(objectIndex)) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		stats.primitiveTests++;
+		Intersection currentIntersect = primitives.spheres[sphereIndices[i]].intersect(ray);
+		if (currentIntersect.distAlongRay < closest.distAlongRay) {
+			closest = currentIntersect;
+			closest.objectIndex = objectIndex;
+		}
+	}
+	// Instances trace the ray through their mesh's tree, which counts its own
+	// work in stats and skips anything behind the closest hit so far
+	for (uint32_t i = leaf.firstInstance; i < leaf.firstInstance + leaf.instanceCount; ++i) {
+		uint32_t objectIndex = primitives.getInstanceObjectIndex(instanceIndices[i]);
+		if (mailbox != nullptr && mailbox->checkAndRecord(objectIndex)) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		Intersection currentIntersect = primitives.instances[instanceIndices[i]].intersect(ray, closest.distAlongRay, stats);
+		if (currentIntersect.distAlongRay < closest.distAlongRay) {
+			closest = currentIntersect;
+			closest.objectIndex = objectIndex;
+		}
+	}
+	return closest.distAlongRay < maxDistance ? closest : Intersection();
+}
+
+bool LinearTree::isLeafOccluded(uint32_t leafIndex, const Ray& ray, float maxDistance, TraversalStats& stats, Mailbox* mailbox) const {
+	const Leaf& leaf = leaves[leafIndex];
+	uint32_t triangleCount = triangleKernel != nullptr ? 0 : leaf.triangleCount;
+	uint32_t blockCount = triangleKernel != nullptr ? (leaf.triangleCount + TriangleBlock::width - 1) / TriangleBlock::width : 0;
+	for (uint32_t i = leaf.firstTriangleBlock; i < leaf.firstTriangleBlock + blockCount; ++i) {
+		const TriangleBlock& block = triangleBlocks[i];
+		int laneMask = getUntestedLanes(block.triangles, block.laneMask, stats, mailbox);
+		TriangleBlock::Hits hits;
+		int edgeMask;
+		if (triangleKernel(block, ray, laneMask, maxDistance, hits, edgeMask) != 0) {
+			return true;
+		}
+		for (int lane = 0; lane < TriangleBlock::width; ++lane) {
+			if ((edgeMask & (1 << lane)) && primitives.triangles[block.triangles[lane]].intersect(ray).distAlongRay < maxDistance) {
+				return true;
+			}
+		}
+	}
+	for (uint32_t i = leaf.firstTriangle; i < leaf.firstTriangle + triangleCount; ++i) {
+		uint32_t triangle = triangleIndices[i];
+		if (mailbox != nullptr && mailbox->checkAndRecord(triangle)) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		stats.primitiveTests++;
+		if (primitives.triangles[triangle].intersect(ray).distAlongRay < maxDistance) {
+			return true;
+		}
+	}
+	for (uint32_t i = leaf.firstSphereBlock; i < leaf.firstSphereBlock + leaf.sphereBlockCount; ++i) {
+		const SphereBlock& block = sphereBlocks[i];
+		int laneMask = getUntestedLanes(block.objects, block.laneMask, stats, mailbox);
+		float distances[SphereBlock::width];
+		if (sphereKernel(block, ray, laneMask, maxDistance, distances) != 0) {
+			return true;
+		}
+	}
+	for (uint32_t i = leaf.firstSphere; i < leaf.firstSphere + leaf.sphereCount; ++i) {
+		if (mailbox != nullptr && mailbox->checkAndRecord(primitives.getSphereObjectIndex(sphereIndices[i]))) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		stats.primitiveTests++;
+		if (primitives.spheres[sphereIndices[i]].intersect(ray).distAlongRay < maxDistance) {
+			return true;
+		}
+	}
+	for (uint32_t i = leaf.firstInstance; i < leaf.firstInstance + leaf.instanceCount; ++i) {
+		if (mailbox != nullptr && mailbox->checkAndRecord(primitives.getInstanceObjectIndex(instanceIndices[i]))) {
+			stats.primitiveTestsAvoided++;
+			continue;
+		}
+		if (primitives.instances[instanceIndices[i]].isOccluded(ray, maxDistance, stats)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Only lanes in laneMask are looked at, so any block width works
+int LinearTree::getUntestedLanes(const uint32_t* objects, int laneMask, TraversalStats& stats, Mailbox* mailbox) const {
+	for (int lane = 0; (laneMask >> lane) != 0; ++lane) {
+		if (!(laneMask & (1 << lane))) {
+			continue;
+		}
+		if (mailbox != nullptr && mailbox->checkAndRecord(objects[lane])) {
+			laneMask &= ~(1 << lane);
+			stats.primitiveTestsAvoided++;
+		}
+		else {
+			stats.primitiveTests++;
+		}
+	}
+	return laneMask;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include "SceneObjects.hpp"
+#include "Shape.h"
+#include "Primitives.h"
+#include "Simd.h"
+#include "AABB.h"
+#include "AccelerationStructure.h"
+
+//Binary tree stored as one contiguous array of nodes. Builders (Partition, BVH)
+//fill in nodes and leaves, traversal is shared.
+class LinearTree : public AccelerationStructure{
+	public:
+		LinearTree(const Primitives& primitives);
+		virtual ~LinearTree();
+		virtual Intersection findClosestIntersection(const Ray& ray, float maxDistance, TraversalStats& stats) const override;
+		virtual bool isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const override;
+		int getNumNodes() const;
+
+	protected:
+		//Builders stop splitting at this depth so traversal can use a fixed size stack
+		static const int maxDepth = 64;
+		//32 bytes. Siblings are stored next to each other so an interior
+		//node only needs the index of its first child.
+		struct LinearNode {
+			glm::vec3 min;
+			//Interior: index of left child, right child is offset + 1
+			//Leaf: index into leaves
+			uint32_t offset;
+			glm::vec3 max;
+			//Number of objects in a leaf, 0 for interior nodes
+			uint32_t count;
+			bool isLeaf() const {
+				return count > 0;
+			}
+		};
+		//Remembers the objects one ray has already been tested against, for
+		//trees that store an object in more than one leaf. Direct mapped, so
+		//an object can occasionally be tested again after being evicted.
+		struct Mailbox {
+			static const int size = 32;
+			uint32_t testedObjects[size];
+			Mailbox() {
+				std::fill(testedObjects, testedObjects + size, std::numeric_limits<uint32_t>::max());
+			}
+			//True if objectIndex was already tested, otherwise records it
+			bool checkAndRecord(uint32_t objectIndex) {
+				uint32_t& slot = testedObjects[objectIndex % size];
+				if (slot == objectIndex) {
+					return true;
+				}
+				slot = objectIndex;
+				return false;
+			}
+		};
+		//The objects of one leaf, split by type into ranges of triangleIndices,
+		//sphereIndices and instanceIndices. When there is a triangleKernel the
+		//triangles are also packed into consecutive triangleBlocks. When there
+		//is a sphereKernel world space spheres go in sphereBlocks instead of
+		//sphereIndices.
+		struct Leaf {
+			uint32_t firstTriangle;
+			uint32_t triangleCount;
+			uint32_t firstSphere;
+			uint32_t sphereCount;
+			uint32_t firstTriangleBlock;
+			uint32_t firstSphereBlock;
+			uint32_t sphereBlockCount;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+		std::vector<LinearNode> nodes;
+		std::vector<Leaf> leaves;
+		//Indices into primitives.triangles, primitives.spheres and primitives.instances
+		std::vector<uint32_t> triangleIndices;
+		std::vector<uint32_t> sphereIndices;
+		std::vector<uint32_t> instanceIndices;
+		std::vector<TriangleBlock> triangleBlocks;
+		std::vector<SphereBlock> sphereBlocks;
+		const Primitives& primitives;
+		//Chosen for the CPU when the tree is made, nullptr to test objects one at a time
+		SimdKernels::TriangleKernel triangleKernel;
+		SimdKernels::SphereKernel sphereKernel;
+		//Set by builders that put an object in every leaf it overlaps
+		bool hasDuplicateObjects = false;
+		uint32_t allocateNodes(int numNodes);
+		void setLeaf(uint32_t nodeIndex, const AABB& box, const std::vector<uint32_t>& leafObjects);
+		void setInterior(uint32_t nodeIndex, const AABB& box, uint32_t firstChild);
+		//Tree made by builders that find their splits before flattening
+		//(BVH, LBVH), flattened into nodes once done
+		struct BuildNode {
+			AABB box;
+			//Range of the builder's objects
+			int start;
+			int end;
+			std::unique_ptr<BuildNode> left = nullptr;
+			std::unique_ptr<BuildNode> right = nullptr;
+			bool isLeaf() const {
+				return left == nullptr;
+			}
+		};
+		//Writes node to nodes[nodeIndex] and its children after it. Leaves
+		//hold the index member of objects[start] to objects[end - 1].
+		template<typename Object>
+		void flatten(const std::vector<Object>& objects, const BuildNode& node, uint32_t nodeIndex);
+		//Test the objects of leaves[leaf] for hits nearer than maxDistance,
+		//skipping any already in mailbox when there is one
+		Intersection intersectLeaf(uint32_t leaf, const Ray& ray, float maxDistance, TraversalStats& stats, Mailbox* mailbox = nullptr) const;
+		bool isLeafOccluded(uint32_t leaf, const Ray& ray, float maxDistance, TraversalStats& stats, Mailbox* mailbox = nullptr) const;
+
+	private:
+		struct StackEntry {
+			uint32_t nodeIndex;
+			float entryDistance;
+		};
+		bool intersectBox(const LinearNode& node, const Ray& ray, float maxDistance, float& entryDistance, TraversalStats& stats) const;
+		void addTriangleBlocks(Leaf& leaf);
+		void addSphereBlocks(Leaf& leaf, const std::vector<uint32_t>& spheres);
+		//Lanes of laneMask whose objects aren't already in mailbox, which
+		//records the rest
+		int getUntestedLanes(const uint32_t* objects, int laneMask, TraversalStats& stats, Mailbox* mailbox) const;
+};
+
+template<typename Object>
+void LinearTree::flatten(const std::vector<Object>& objects, const BuildNode& node, uint32_t nodeIndex) {
+	if (node.isLeaf()) {
+		std::vector<uint32_t> leafObjects;
+		for (int i = node.start; i < node.end; ++i) {
+			leafObjects.push_back(objects[i].index);
+		}
+		setLeaf(nodeIndex, node.box, leafObjects);
+	}
+	else {
+		uint32_t firstChild = allocateNodes(2);
+		setInterior(nodeIndex, node.box, firstChild);
+		flatten(objects, *node.left, firstChild);
+		flatten(objects, *node.right, firstChild + 1);
+	}
+}
@@ -0,0 +1,87 @@
+#include "MeshInstance.h"
+#include "InstancedMesh.h"
+#include "AABB.h"
+#include <limits>
+
+MeshInstance::MeshInstance(const InstancedMesh& mesh, const glm::mat4& transform, uint32_t materialIndex) : mesh(&mesh), materialIndex(materialIndex) {
+	inverseTransform = glm::inverse(transform);
+	normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+	//Without vertex normals the mesh uses the normals of its triangles'
+	//planes. A mirroring transform flips those when the vertices are moved
+	//into world space, so flip them here too.
+	if (!mesh.mesh.hasNormals() && glm::determinant(glm::mat3(transform)) < 0.0f) {
+		normalTransform = -normalTransform;
+	}
+	//Bounds of the moved vertices are tighter than the moved object space box
+	worldMin = glm::vec3(std::numeric_limits<float>::infinity());
+	worldMax = glm::vec3(-std::numeric_limits<float>::infinity());
+	for (uint32_t triangle = 0; triangle < mesh.mesh.getNumTriangles(); ++triangle) {
+		for (int corner = 0; corner < 3; ++corner) {
+			glm::vec3 vertex = transform * glm::vec4(mesh.mesh.getVertex(triangle, corner), 1.0f);
+			worldMin = glm::min(worldMin, vertex);
+			worldMax = glm::max(worldMax, vertex);
+		}
+	}
+}
+
+MeshInstance::~MeshInstance() {
+}
+
+float MeshInstance::getMinX() const {
+	return worldMin.x;
+}
+
+float MeshInstance::getMinY() const {
+	return worldMin.y;
+}
+
+float MeshInstance::getMinZ() const {
+	return worldMin.z;
+}
+
+float MeshInstance::getMaxX() const {
+	return worldMax.x;
+}
+
+float MeshInstance::getMaxY() const {
+	return worldMax.y;
+}
+
+float MeshInstance::getMaxZ() const {
+	return worldMax.z;
+}
+
+bool MeshInstance::isInside(const AABB& box) const {
+	glm::vec3 boxMin = box.getMin();
+	glm::vec3 boxMax = box.getMax();
+	return worldMin.x <= boxMax.x && worldMax.x >= boxMin.x && worldMin.y <= boxMax.y && worldMax.y >= boxMin.y && worldMin.z <= boxMax.z && worldMax.z >= boxMin.z;
+}
+
+glm::vec3 MeshInstance::getNormal(const glm::vec3& /*point*/, const Intersection& hit) const {
+	return glm::normalize(normalTransform * mesh->mesh.getNormal(hit.instancedObjectIndex, hit.barycentrics));
+}
+
+uint32_t MeshInstance::getMaterialIndex() const {
+	return materialIndex;
+}
+
+Intersection MeshInstance::intersect(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	float scale;
+	Ray objectRay = toObjectSpace(ray, scale);
+	Intersection hit = mesh->tree->findClosestIntersection(objectRay, maxDistance * scale, stats);
+	hit.distAlongRay /= scale;
+	hit.instancedObjectIndex = hit.objectIndex;
+	return hit;
+}
+
+bool MeshInstance::isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	float scale;
+	Ray objectRay = toObjectSpace(ray, scale);
+	return mesh->tree->isOccluded(objectRay, maxDistance * scale, stats);
+}
+
+Ray MeshInstance::toObjectSpace(const Ray& ray, float& scale) const {
+	glm::vec3 dir = glm::mat3(inverseTransform) * ray.dir;
+	scale = glm::length(dir);
+	return Ray(glm::vec3(inverseTransform * glm::vec4(ray.origin, 1.0f)), dir / scale);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include "Shape.h"
+#include "RenderStats.h"
+
+struct InstancedMesh;
+
+//One placement of an InstancedMesh in the scene. Rays are moved into the
+//mesh's object space and traced through the mesh's own tree, so every
+//instance shares one copy of the triangles and one tree.
+class MeshInstance final :
+	public Shape
+{
+	public:
+		//transform takes the mesh from object space to world space
+		MeshInstance(const InstancedMesh& mesh, const glm::mat4& transform, uint32_t materialIndex);
+		virtual ~MeshInstance();
+		virtual float getMinX() const override;
+		virtual float getMinY() const override;
+		virtual float getMinZ() const override;
+		virtual float getMaxX() const override;
+		virtual float getMaxY() const override;
+		virtual float getMaxZ() const override;
+		//True if box overlaps the instance's bounds
+		virtual bool isInside(const AABB& box) const override;
+		//Normal of the mesh at hit, moved into world space
+		virtual glm::vec3 getNormal(const glm::vec3& point, const Intersection& hit) const override;
+		virtual uint32_t getMaterialIndex() const override;
+		//Closest hit in the mesh nearer than maxDistance, instancedObjectIndex
+		//is the triangle hit. Distances are world space distances along ray.
+		//Takes the place of Shape::intersect so traversal counts the work.
+		Intersection intersect(const Ray& ray, float maxDistance, TraversalStats& stats) const;
+		bool isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const;
+
+	private:
+		const InstancedMesh* mesh;
+		glm::mat4 inverseTransform;
+		glm::mat3 normalTransform;
+		glm::vec3 worldMin;
+		glm::vec3 worldMax;
+		uint32_t materialIndex;
+		//ray moved into object space, with its direction normalized again.
+		//Distances along it are scale times those along ray.
+		Ray toObjectSpace(const Ray& ray, float& scale) const;
+};
@@ -1,20 +1,25 @@
 #include "Partition.h"
 #include <algorithm>
+#include "TaskScheduler.h"
 
-Partition::Partition(const std::vector<Shape*>& objects){
+Partition::Partition(const Primitives& primitives) : LinearTree(primitives){
+	hasDuplicateObjects = true;
 	AABB box;
-	for (Shape* obj : objects) {
-		box.expand(*obj);
+	for (uint32_t i = 0; i < primitives.getNumObjects(); ++i) {
+		box.expand(primitives.getObject(i));
 	}
-	root = new PartitionNode(box, objects.size());
-	for (Shape* obj : objects) {
-		insert(obj, root);
+	PartitionNode* root = new PartitionNode(box, primitives.getNumObjects());
+	for (uint32_t i = 0; i < primitives.getNumObjects(); ++i) {
+		insert(i, root);
 	}
-	split(root, 0);
+	split(root, 0, 0);
+	if (!isEmptySubtree(root)) {
+		flatten(skipEmptyChildren(root), allocateNodes(1));
+	}
+	deallocateTree(root);
 }
 
 Partition::~Partition(){
-	deallocateTree(root);
 }
 
 void Partition::deallocateTree(PartitionNode*& node) {
@@ -28,58 +33,68 @@ void Partition::deallocateTree(PartitionNode*& node) {
 	}
 }
 
-Intersection Partition::findClosestintersection(const Ray& ray) const {
-	return intersect(ray, root);
-}
-
-Intersection Partition::intersect(const Ray& ray, PartitionNode const * const currentNode) const {
-	if (currentNode == nullptr || !currentNode->box.intersect(ray).isValidIntersection()) {
-		return Intersection();
+bool Partition::isEmptySubtree(PartitionNode const * const node) const {
+	if (node == nullptr) {
+		return true;
 	}
-	else if (currentNode->isLeaf()) {
-		return currentNode->findClosestIntersection(ray);
+	else if (node->isLeaf()) {
+		return node->isEmpty();
 	}
-	Intersection left = intersect(ray, currentNode->left);
-	Intersection right = intersect(ray, currentNode->right);
-	if (!(left.isValidIntersection() || right.isValidIntersection())) {
-		return Intersection();
+	return isEmptySubtree(node->left) && isEmptySubtree(node->right);
+}
+
+//Nodes with only one non-empty child are replaced by that child
+Partition::PartitionNode* Partition::skipEmptyChildren(PartitionNode* node) const {
+	while (!node->isLeaf()) {
+		if (isEmptySubtree(node->left)) {
+			node = node->right;
+		}
+		else if (isEmptySubtree(node->right)) {
+			node = node->left;
+		}
+		else {
+			break;
+		}
 	}
-	else if ((left.isValidIntersection() && !right.isValidIntersection()) || left.distAlongRay <= right.distAlongRay) {
-		return left;
+	return node;
+}
+
+void Partition::flatten(PartitionNode* node, uint32_t nodeIndex) {
+	if (node->isLeaf()) {
+		setLeaf(nodeIndex, node->box, node->objects);
 	}
-	else{
-		return right;
+	else {
+		uint32_t firstChild = allocateNodes(2);
+		setInterior(nodeIndex, node->box, firstChild);
+		flatten(skipEmptyChildren(node->left), firstChild);
+		flatten(skipEmptyChildren(node->right), firstChild + 1);
 	}
 }
 
-bool Partition::insert(Shape* obj, PartitionNode* nodeToInsert) {
-	if (nodeToInsert->isLeaf() && nodeToInsert->box.contains(*obj)) {
-		nodeToInsert->objects.push_back(obj);
+bool Partition::insert(uint32_t objectIndex, PartitionNode* nodeToInsert) {
+	if (nodeToInsert->isLeaf() && nodeToInsert->box.contains(primitives.getObject(objectIndex))) {
+		nodeToInsert->objects.push_back(objectIndex);
 		return true;
 	}
 	else {
 		bool inLeft = false, inRight = false;
 		//Object might be in both left and right so checking here.
-		if (nodeToInsert->left != nullptr && nodeToInsert->left->box.contains(*obj)) {
-			inLeft = insert(obj, nodeToInsert->left);
+		if (nodeToInsert->left != nullptr && nodeToInsert->left->box.contains(primitives.getObject(objectIndex))) {
+			inLeft = insert(objectIndex, nodeToInsert->left);
 		}
-		if (nodeToInsert->right != nullptr && nodeToInsert->right->box.contains(*obj)) {
-			inRight = insert(obj, nodeToInsert->right);
+		if (nodeToInsert->right != nullptr && nodeToInsert->right->box.contains(primitives.getObject(objectIndex))) {
+			inRight = insert(objectIndex, nodeToInsert->right);
 		}
 		return inLeft || inRight;
-	} 
-}
-
-void Partition::insert(Shape*obj) {
-	insert(obj, root);
+	}
 }
 
-void Partition::split(PartitionNode* nodeToSplit, int prevMatches) {
-	if (nodeToSplit != nullptr && nodeToSplit->isLeaf() && (static_cast<float>(prevMatches)/nodeToSplit->objects.size()) < splitThreshold) {
+void Partition::split(PartitionNode* nodeToSplit, int prevMatches, int depth) {
+	if (nodeToSplit != nullptr && nodeToSplit->isLeaf() && depth < maxDepth && (static_cast<float>(prevMatches)/nodeToSplit->objects.size()) < splitThreshold) {
 		nodeToSplit->left = new PartitionNode(nodeToSplit->box.splitLeft(), nodeToSplit->objects.size());
 		nodeToSplit->right = new PartitionNode(nodeToSplit->box.splitRight(), nodeToSplit->objects.size());
 		int matches = 0;
-		for (Shape* obj : nodeToSplit->objects) {
+		for (uint32_t obj : nodeToSplit->objects) {
 			bool inLeft = insert(obj, nodeToSplit->left);
 			bool inRight = insert(obj, nodeToSplit->right);
 			if (inLeft && inRight) {
@@ -95,7 +110,19 @@ void Partition::split(PartitionNode* nodeToSplit, int prevMatches) {
 			delete nodeToSplit->right;
 			nodeToSplit->right = nullptr;
 		}
-		split(nodeToSplit->left, matches);
-		split(nodeToSplit->right, matches);
+		//The children only touch their own subtrees, so big ones are split
+		//on other threads
+		if (nodeToSplit->objects.size() >= parallelSplitSize) {
+			TaskScheduler::TaskGroup children;
+			children.run([this, nodeToSplit, matches, depth]() {
+				split(nodeToSplit->left, matches, depth + 1);
+			});
+			split(nodeToSplit->right, matches, depth + 1);
+			children.wait();
+		}
+		else {
+			split(nodeToSplit->left, matches, depth + 1);
+			split(nodeToSplit->right, matches, depth + 1);
+		}
 	}
 }
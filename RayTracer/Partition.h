@@ -3,48 +3,38 @@
 #include "SceneObjects.hpp"
 #include "Shape.h"
 #include "AABB.h"
+#include "LinearTree.h"
 
-class Partition{
+class Partition : public LinearTree{
 	public:
-		Partition(const std::vector<Shape*>& objects);
-		~Partition();
-		void insert(Shape* object);
-		Intersection findClosestintersection(const Ray& ray) const;
+		Partition(const Primitives& primitives);
+		virtual ~Partition();
 
 	private:
 		float splitThreshold = 0.5f;
+		//Nodes with fewer objects split their children on the same thread
+		size_t parallelSplitSize = 1024;
+		//Only used while building, the finished tree is flattened into LinearTree::nodes
 		struct PartitionNode {
 			int parentObjectCount;
 			AABB box;
 			PartitionNode* left = nullptr;
 			PartitionNode* right = nullptr;
-			std::vector<Shape *> objects;
+			std::vector<uint32_t> objects;
 			bool isEmpty() const {
 				return objects.size() == 0;
 			}
 			bool isLeaf() const {
 				return left == nullptr && right == nullptr;
 			}
-			Intersection findClosestIntersection(const Ray& ray) const {
-				Intersection objIntersect;
-
-				for (Shape* obj: objects) {
-					Intersection currentIntersect = obj->intersect(ray);
-					if (currentIntersect.isValidIntersection() && (currentIntersect.distAlongRay < objIntersect.distAlongRay || !objIntersect.isValidIntersection())) {
-						objIntersect = currentIntersect;
-						objIntersect.mat = obj->getMaterial();
-					}
-				}
-				return objIntersect;
-			}
 			PartitionNode(const glm::vec3& minBound, const glm::vec3& maxBound, int parentObjectCount) : box(minBound, maxBound), parentObjectCount(parentObjectCount) {
 			}
 			PartitionNode(const AABB& box, int parentObjectCount) : box(box), parentObjectCount(parentObjectCount) {}
 		};
-		void split(PartitionNode* nodeToSplit, int prevMatches);
-		bool insert(Shape* object, PartitionNode* nodeToInsert);
-		Intersection intersect(const Ray& ray, PartitionNode const * const currentNode) const;
-		PartitionNode* root;
+		void split(PartitionNode* nodeToSplit, int prevMatches, int depth);
+		bool insert(uint32_t objectIndex, PartitionNode* nodeToInsert);
+		bool isEmptySubtree(PartitionNode const * const node) const;
+		PartitionNode* skipEmptyChildren(PartitionNode* node) const;
+		void flatten(PartitionNode* node, uint32_t nodeIndex);
 		void deallocateTree(PartitionNode*& node);
 };
-
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Shape.h"
+#include "Sphere.h"
+#include "TriangleMesh.h"
+#include "MeshInstance.h"
+
+//Scene objects kept by type in contiguous arrays, so traversal can test each
+//type in its own loop with direct calls. Objects are numbered with every
+//triangle first, then every sphere, then every instance.
+struct Primitives {
+	std::vector<MeshTriangle> triangles;
+	std::vector<Sphere> spheres;
+	std::vector<MeshInstance> instances;
+
+	uint32_t getNumObjects() const {
+		return triangles.size() + spheres.size() + instances.size();
+	}
+	uint32_t getSphereObjectIndex(uint32_t sphere) const {
+		return triangles.size() + sphere;
+	}
+	uint32_t getInstanceObjectIndex(uint32_t instance) const {
+		return triangles.size() + spheres.size() + instance;
+	}
+	bool isInstance(uint32_t objectIndex) const {
+		return objectIndex >= getInstanceObjectIndex(0);
+	}
+	const MeshInstance& getInstance(uint32_t objectIndex) const {
+		return instances[objectIndex - getInstanceObjectIndex(0)];
+	}
+	//For building and shading, where one virtual call per object is cheap
+	const Shape& getObject(uint32_t objectIndex) const {
+		if (objectIndex < triangles.size()) {
+			return triangles[objectIndex];
+		}
+		if (isInstance(objectIndex)) {
+			return getInstance(objectIndex);
+		}
+		return spheres[objectIndex - triangles.size()];
+	}
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+//Work done by an acceleration structure while answering ray queries
+struct TraversalStats {
+	//Nodes the ray entered and whose children or objects were tested
+	unsigned long long nodesVisited = 0;
+	unsigned long long boxTests = 0;
+	unsigned long long primitiveTests = 0;
+	//Tests skipped because the object was already tested against the same ray
+	unsigned long long primitiveTestsAvoided = 0;
+
+	TraversalStats& operator+=(const TraversalStats& other) {
+		nodesVisited += other.nodesVisited;
+		boxTests += other.boxTests;
+		primitiveTests += other.primitiveTests;
+		primitiveTestsAvoided += other.primitiveTestsAvoided;
+		return *this;
+	}
+};
+
+//Counters kept by each render thread and added together once rendering ends
+struct RenderStats {
+	unsigned long long primaryRays = 0;
+	unsigned long long shadowRays = 0;
+	unsigned long long reflectionRays = 0;
+	TraversalStats primary;
+	TraversalStats shadow;
+	TraversalStats reflection;
+
+	unsigned long long getTotalRays() const {
+		return primaryRays + shadowRays + reflectionRays;
+	}
+
+	TraversalStats getTotalTraversal() const {
+		TraversalStats total = primary;
+		total += shadow;
+		total += reflection;
+		return total;
+	}
+
+	RenderStats& operator+=(const RenderStats& other) {
+		primaryRays += other.primaryRays;
+		shadowRays += other.shadowRays;
+		reflectionRays += other.reflectionRays;
+		primary += other.primary;
+		shadow += other.shadow;
+		reflection += other.reflection;
+		return *this;
+	}
+};
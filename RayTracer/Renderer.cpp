@@ -1,15 +1,118 @@
 #include "Renderer.h"
 
+#ifdef RAYTRACER_NO_FREEIMAGE
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+//Minimal PNG encoder used when FreeImage isn't available. Image data is
+//stored with uncompressed deflate blocks so no zlib is needed.
+namespace {
+	std::vector<uint32_t> buildCrcTable() {
+		std::vector<uint32_t> table(256);
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	uint32_t crc32(const std::vector<unsigned char>& data, size_t start) {
+		static const std::vector<uint32_t> table = buildCrcTable();
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = start; i < data.size(); i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+		out.push_back((value >> 24) & 0xFF);
+		out.push_back((value >> 16) & 0xFF);
+		out.push_back((value >> 8) & 0xFF);
+		out.push_back(value & 0xFF);
+	}
+
+	void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+		std::vector<unsigned char> chunk;
+		appendBigEndian(chunk, data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		//CRC covers the chunk type and data but not the length
+		appendBigEndian(chunk, crc32(chunk, 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+}
+#endif
+
 Renderer::Renderer(int w, int h) : width(w), height(h) {
+#ifndef RAYTRACER_NO_FREEIMAGE
 	FreeImage_Initialise();
+#endif
 }
 
 
 Renderer::~Renderer() {
+#ifndef RAYTRACER_NO_FREEIMAGE
 	FreeImage_DeInitialise();
+#endif
 }
 
+#ifndef RAYTRACER_NO_FREEIMAGE
 void Renderer::createImage(BYTE* pixels, std::string outputFileName) {
 	FIBITMAP* img = FreeImage_ConvertFromRawBits(pixels, width, height, width * 3, 24, 0xFF0000, 0x00FF00, 0x0000FF, true);
 	FreeImage_Save(FIF_PNG, img, outputFileName.c_str(), 0);
 }
+#else
+//Pixels are BGR, top row first
+void Renderer::createImage(BYTE* pixels, std::string outputFileName) {
+	std::vector<unsigned char> raw;
+	raw.reserve((width * 3 + 1) * height);
+	for (int i = 0; i < height; i++) {
+		//Filter type 0, no filtering
+		raw.push_back(0);
+		for (int j = 0; j < width; j++) {
+			BYTE* pixel = pixels + (i * width + j) * 3;
+			raw.push_back(pixel[2]);
+			raw.push_back(pixel[1]);
+			raw.push_back(pixel[0]);
+		}
+	}
+
+	std::vector<unsigned char> header;
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	//8 bit depth, truecolor, default compression, filter and interlace methods
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });
+
+	std::vector<unsigned char> zlibData = { 0x78, 0x01 };
+	const size_t maxBlockSize = 65535;
+	for (size_t offset = 0; offset < raw.size(); offset += maxBlockSize) {
+		size_t blockSize = std::min(maxBlockSize, raw.size() - offset);
+		bool lastBlock = offset + blockSize == raw.size();
+		zlibData.push_back(lastBlock ? 1 : 0);
+		zlibData.push_back(blockSize & 0xFF);
+		zlibData.push_back((blockSize >> 8) & 0xFF);
+		zlibData.push_back(~blockSize & 0xFF);
+		zlibData.push_back((~blockSize >> 8) & 0xFF);
+		zlibData.insert(zlibData.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+	}
+	uint32_t a = 1, b = 0;
+	for (unsigned char byte : raw) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	appendBigEndian(zlibData, (b << 16) | a);
+
+	std::ofstream file(outputFileName, std::ios::binary);
+	const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	writeChunk(file, "IHDR", header);
+	writeChunk(file, "IDAT", zlibData);
+	writeChunk(file, "IEND", std::vector<unsigned char>());
+}
+#endif
@@ -3,8 +3,63 @@
 #include <sstream>
 #include <glm/glm.hpp>
 #include <stack>
+#include <unordered_map>
+#include <chrono>
+#include <map>
+#include <limits>
 #include "Scene.h"
 #include "Transform.h"
+#include "Partition.h"
+#include "BVH.h"
+#include "WideBVH.h"
+#include "LBVH.h"
+#include "TaskScheduler.h"
+
+namespace {
+	AccelerationStructure* createTree(TreeType treeType, const Primitives& primitives) {
+		if (treeType == TreeType::PARTITION) {
+			return new Partition(primitives);
+		}
+		else if (treeType == TreeType::BVH4) {
+			return new WideBVH<4>(primitives);
+		}
+		else if (treeType == TreeType::BVH8) {
+			return new WideBVH<8>(primitives);
+		}
+		else if (treeType == TreeType::LBVH) {
+			return new LBVH(primitives);
+		}
+		return new BVH(primitives);
+	}
+
+	//Adds the triangles of vertices (three scene vertex indices each) to mesh,
+	//moved by transform. Vertices shared between triangles are stored once.
+	void addTriangles(TriangleMesh& mesh, const std::vector<int>& vertices, bool withNormals, const glm::mat4& transform, const glm::vec3* verts, const glm::vec3* vertNorms) {
+		glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+		//Scene vertex index to mesh vertex index
+		std::unordered_map<int, uint32_t> meshVertices;
+		for (size_t first = 0; first < vertices.size(); first += 3) {
+			uint32_t triangleVertices[3];
+			for (int i = 0; i < 3; ++i) {
+				int sceneVertex = vertices[first + i];
+				std::unordered_map<int, uint32_t>::iterator found = meshVertices.find(sceneVertex);
+				if (found == meshVertices.end()) {
+					uint32_t meshVertex;
+					//vertexnormal stores each position followed by its normal
+					if (withNormals) {
+						meshVertex = mesh.addVertex(transform * glm::vec4(vertNorms[2 * sceneVertex], 1.0f), normalTransform * vertNorms[2 * sceneVertex + 1]);
+					}
+					else {
+						meshVertex = mesh.addVertex(transform * glm::vec4(verts[sceneVertex], 1.0f));
+					}
+					found = meshVertices.insert(std::make_pair(sceneVertex, meshVertex)).first;
+				}
+				triangleVertices[i] = found->second;
+			}
+			mesh.addTriangle(triangleVertices[0], triangleVertices[1], triangleVertices[2]);
+		}
+	}
+}
 
 void Scene::setDefaults() {
 	attenuation = glm::vec3(1.0f, 0.0f, 0.0f);
@@ -12,7 +67,7 @@ void Scene::setDefaults() {
 	outputFileName = "test.png";
 }
 
-Scene::Scene(const std::string& fileName){
+Scene::Scene(const std::string& fileName, TreeType treeType, bool instanceMeshes){
 	Color diffuse = Color(0.0f, 0.0f, 0.0f), specular = Color(0.0f, 0.0f,0.0f), emission = Color(0.0f, 0.0f, 0.0f), ambient = Color(0.2f, 0.2f, 0.2f);
 	int numObjects = 0, maxObjects = 200;
 	int numVerts, numVertNorms;
@@ -21,9 +76,18 @@ Scene::Scene(const std::string& fileName){
 	int vertIndex = 0;
 	int vertNormIndex = 0;
 	float shininess = 0;
+	//Bumped whenever a material property changes so the table is only searched
+	//for the first object after a change
+	int materialVersion = 0;
+	int materialIndexVersion = -1;
+	uint32_t materialIndex = 0;
+	//Following triangles go in the last block while the material, transform
+	//and kind of vertex stay the same
+	std::vector<MeshBlock> meshBlocks;
 	setDefaults();
 	std::string line, cmd;
 	int numUsed = 0, numLights = 100;
+	std::chrono::steady_clock::time_point parseStart = std::chrono::steady_clock::now();
 	std::ifstream inFile;
 	inFile.open(fileName);
 	if (inFile.is_open()) {
@@ -92,30 +156,35 @@ Scene::Scene(const std::string& fileName){
 					isValidInput = readvals(s, 3, values);
 					if (isValidInput) {
 						ambient = Color((float)values[0], (float)values[1], (float)values[2]);
+						materialVersion++;
 					}
 				}
 				else if (cmd == "diffuse") {
 					isValidInput = readvals(s, 3, values);
 					if (isValidInput) {
 						diffuse = Color(values[0], values[1], values[2]);
+						materialVersion++;
 					}
 				}
 				else if (cmd == "specular") {
 					isValidInput = readvals(s, 3, values);
 					if (isValidInput) {
 						specular = Color(values[0], values[1], values[2]);
+						materialVersion++;
 					}
 				}
 				else if (cmd == "emission") {
 					isValidInput = readvals(s, 3, values);
 					if (isValidInput) {
 						emission = Color(values[0], values[1], values[2]);
+						materialVersion++;
 					}
 				}
 				else if (cmd == "shininess") {
 					isValidInput = readvals(s, 1, values);
 					if (isValidInput) {
 						shininess = values[0];
+						materialVersion++;
 					}
 				}
 				else if (cmd == "size") {
@@ -143,34 +212,33 @@ Scene::Scene(const std::string& fileName){
 						cam = Camera(glm::vec3(values[0], values[1], values[2]), glm::vec3(values[3], values[4], values[5]), glm::vec3(values[6], values[7], values[8]), values[9]);
 					}
 				}
-				else if (cmd == "sphere" || cmd == "tri" || cmd == "trinormal") {
-							Material mat(diffuse, specular, emission, ambient, shininess);
-							Shape* obj;
-
-							if (cmd == "sphere") {
-								isValidInput = readvals(s, 4, values);
-								if (isValidInput) {
-									obj = new Sphere(glm::vec3(values[0], values[1], values[2]), values[3], transfstack.top(), mat);
-									objects.push_back(obj);
-									numSpheres++;
-								}
-							}
-							else if (cmd == "tri") {
-								isValidInput = readvals(s, 3, values);
-								if (isValidInput) {
-									obj = new Triangle(verts[(int)values[0]], verts[(int)values[1]], verts[(int)values[2]], transfstack.top(), mat);
-									objects.push_back(obj);
-									numTriangles++;
-								}
-							}
-							else if (cmd == "trinormal") {
-								isValidInput = readvals(s, 6, values);
-								if (isValidInput) {
-									obj = new Triangle(vertNorms[(int)values[0]], vertNorms[(int)values[2]], vertNorms[(int)values[4]], transfstack.top(), mat, vertNorms[(int)values[1]], vertNorms[(int)values[3]], vertNorms[(int)values[5]]);
-									objects.push_back(obj);
-									numTriangles++;
-								}
-							}
+				else if (cmd == "sphere") {
+					isValidInput = readvals(s, 4, values);
+					if (isValidInput) {
+						if (materialIndexVersion != materialVersion) {
+							materialIndex = findOrAddMaterial(Material(diffuse, specular, emission, ambient, shininess));
+							materialIndexVersion = materialVersion;
+						}
+						primitives.spheres.push_back(Sphere(glm::vec3(values[0], values[1], values[2]), values[3], transfstack.top(), materialIndex));
+						numSpheres++;
+					}
+				}
+				else if (cmd == "tri" || cmd == "trinormal") {
+					isValidInput = readvals(s, 3, values);
+					if (isValidInput) {
+						bool withNormals = cmd == "trinormal";
+						if (materialIndexVersion != materialVersion) {
+							materialIndex = findOrAddMaterial(Material(diffuse, specular, emission, ambient, shininess));
+							materialIndexVersion = materialVersion;
+						}
+						if (meshBlocks.empty() || meshBlocks.back().materialIndex != materialIndex || meshBlocks.back().withNormals != withNormals || meshBlocks.back().transform != transfstack.top()) {
+							meshBlocks.push_back(MeshBlock{ materialIndex, withNormals, transfstack.top(), std::vector<int>() });
+						}
+						for (int i = 0; i < 3; ++i) {
+							meshBlocks.back().vertices.push_back((int)values[i]);
+						}
+						numTriangles++;
+					}
 				}
 				else if (cmd == "translate") {
 					isValidInput = readvals(s, 3, values);
@@ -207,8 +275,19 @@ Scene::Scene(const std::string& fileName){
 			}
 				std::getline(inFile, line);
 			}
+			addMeshes(meshBlocks, verts, vertNorms, instanceMeshes);
 			isLoaded = true;
-			objectTree = new Partition(objects);
+			std::chrono::steady_clock::time_point buildStart = std::chrono::steady_clock::now();
+			parseTimeInSeconds = std::chrono::duration<double>(buildStart - parseStart).count();
+			//Every instanced mesh's tree, then the tree over the instances and
+			//everything else
+			TaskScheduler::get().parallelFor(0, instancedMeshes.size(), 1, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; ++i) {
+					instancedMeshes[i]->tree.reset(createTree(treeType, instancedMeshes[i]->primitives));
+				}
+			});
+			objectTree = createTree(treeType, primitives);
+			buildTimeInSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
 	}else{
 		isLoaded = false;
 		std::cout << "Unable to open file " << fileName << std::endl;
@@ -224,11 +303,49 @@ Scene::Scene(const std::string& fileName){
 }
 
 Scene::~Scene(){
-	objectTree->~Partition();
 	delete objectTree;
-	for (Shape* obj : objects) {
-		delete obj;
-		obj = nullptr;
+	for (TriangleMesh* mesh : meshes) {
+		delete mesh;
+	}
+	for (InstancedMesh* instancedMesh : instancedMeshes) {
+		delete instancedMesh;
+	}
+}
+
+// Blocks made of the same triangles over the same kind of vertex are the same
+// geometry placed differently. When instancing, geometry used by more than one
+// block is stored once in object space and each block becomes a MeshInstance
+// of it. Everything else is moved into world space.
+void Scene::addMeshes(const std::vector<MeshBlock>& blocks, const glm::vec3* verts, const glm::vec3* vertNorms, bool instanceMeshes) {
+	typedef std::pair<bool, std::vector<int>> Geometry;
+	std::map<Geometry, int> uses;
+	if (instanceMeshes) {
+		for (const MeshBlock& block : blocks) {
+			uses[Geometry(block.withNormals, block.vertices)]++;
+		}
+	}
+	std::map<Geometry, InstancedMesh*> shared;
+	for (const MeshBlock& block : blocks) {
+		if (instanceMeshes && uses[Geometry(block.withNormals, block.vertices)] > 1) {
+			InstancedMesh*& instancedMesh = shared[Geometry(block.withNormals, block.vertices)];
+			if (instancedMesh == nullptr) {
+				instancedMesh = new InstancedMesh(block.materialIndex);
+				instancedMeshes.push_back(instancedMesh);
+				addTriangles(instancedMesh->mesh, block.vertices, block.withNormals, glm::mat4(1.0f), verts, vertNorms);
+				for (uint32_t i = 0; i < instancedMesh->mesh.getNumTriangles(); ++i) {
+					instancedMesh->primitives.triangles.push_back(MeshTriangle(instancedMesh->mesh, i));
+				}
+			}
+			primitives.instances.push_back(MeshInstance(*instancedMesh, block.transform, block.materialIndex));
+		}
+		else {
+			TriangleMesh* mesh = new TriangleMesh(block.materialIndex);
+			meshes.push_back(mesh);
+			addTriangles(*mesh, block.vertices, block.withNormals, block.transform, verts, vertNorms);
+			for (uint32_t i = 0; i < mesh->getNumTriangles(); ++i) {
+				primitives.triangles.push_back(MeshTriangle(*mesh, i));
+			}
+		}
 	}
 }
 
@@ -247,8 +364,8 @@ const Camera& Scene::getCamera() const {
 	return cam;
 }
 
-const std::vector<Shape *>& Scene::getSceneObjects() const {
-	return objects;
+const Primitives& Scene::getPrimitives() const {
+	return primitives;
 }
 
 const std::string& Scene::getOutputFileName() const {
@@ -269,7 +386,11 @@ const std::vector<Light>& Scene::getLights() const {
 }
 
 int Scene::getNumObjects() const {
-	return objects.size();
+	return primitives.getNumObjects();
+}
+
+const Material& Scene::getMaterial(uint32_t index) const {
+	return materials[index];
 }
 
 int Scene::getNumSpheres() const {
@@ -280,6 +401,18 @@ int Scene::getNumTriangles() const {
 	return numTriangles;
 }
 
+int Scene::getNumMeshes() const {
+	return meshes.size() + instancedMeshes.size();
+}
+
+int Scene::getNumInstances() const {
+	return primitives.instances.size();
+}
+
+int Scene::getNumInstancedMeshes() const {
+	return instancedMeshes.size();
+}
+
 int Scene::getNumLights() const {
 	return numPointLights + numDirectionalLights;
 }
@@ -292,10 +425,55 @@ int Scene::getNumPointLights() const {
 	return numPointLights;
 }
 
+double Scene::getParseTimeInSeconds() const {
+	return parseTimeInSeconds;
+}
+
+double Scene::getBuildTimeInSeconds() const {
+	return buildTimeInSeconds;
+}
+
 bool Scene::loaded() const {
 	return isLoaded;
 }
 
-Intersection Scene::findClosestIntersection(const Ray& ray) const {
-	return objectTree->findClosestintersection(ray);
+Intersection Scene::findClosestIntersection(const Ray& ray, TraversalStats& stats) const {
+	Intersection closest = objectTree->findClosestIntersection(ray, std::numeric_limits<float>::infinity(), stats);
+	completeIntersection(ray, closest);
+	return closest;
+}
+
+bool Scene::isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	return objectTree->isOccluded(ray, maxDistance, stats);
+}
+
+void Scene::findClosestIntersections(const std::vector<Ray>& rays, Intersection* closest, TraversalStats& stats) const {
+	objectTree->findClosestIntersections(rays, closest, stats);
+	for (size_t i = 0; i < rays.size(); ++i) {
+		completeIntersection(rays[i], closest[i]);
+	}
+}
+
+void Scene::findOccluded(const std::vector<Ray>& rays, const float* maxDistances, bool* occluded, TraversalStats& stats) const {
+	objectTree->findOccluded(rays, maxDistances, occluded, stats);
+}
+
+void Scene::completeIntersection(const Ray& ray, Intersection& hit) const {
+	if (hit.isValidIntersection()) {
+		const Shape& obj = primitives.getObject(hit.objectIndex);
+		hit.intersectNormal = obj.getNormal(ray.origin + ray.dir * hit.distAlongRay, hit);
+		hit.materialIndex = obj.getMaterialIndex();
+	}
+}
+
+// Scenes set the same few materials over and over, so a linear search is
+// enough to keep one copy of each.
+uint32_t Scene::findOrAddMaterial(const Material& mat) {
+	for (uint32_t i = 0; i < materials.size(); ++i) {
+		if (materials[i] == mat) {
+			return i;
+		}
+	}
+	materials.push_back(mat);
+	return materials.size() - 1;
 }
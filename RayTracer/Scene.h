@@ -5,45 +5,88 @@
 
 #include "SceneObjects.hpp"
 #include "Camera.h"
-#include "Partition.h"
+#include "AccelerationStructure.h"
 #include "Shape.h"
 #include "Sphere.h"
-#include "Triangle.h"
+#include "TriangleMesh.h"
+#include "Primitives.h"
+#include "InstancedMesh.h"
+
+enum class TreeType {
+	PARTITION,
+	BVH,
+	BVH4,
+	BVH8,
+	LBVH
+};
 
 class Scene
 {
 	public:
-		Scene(const std::string& fileName);
+		//With instanceMeshes, geometry repeated under different transforms is
+		//stored and built once and placed with MeshInstances
+		Scene(const std::string& fileName, TreeType treeType = TreeType::BVH, bool instanceMeshes = true);
 		~Scene();
 		bool readvals(std::stringstream &s, int numvals, float * values);
 		void setDefaults();
 
 		const Camera& getCamera() const;
-		const std::vector<Shape *>& getSceneObjects() const;
+		const Primitives& getPrimitives() const;
 		const std::string& getOutputFileName() const;
 		const unsigned int getWidth() const;
 		const unsigned int getHeight() const;
 		const std::vector<Light>& getLights() const;
+		const Material& getMaterial(uint32_t index) const;
 		int getNumObjects() const;
 		int getNumSpheres() const;
 		int getNumTriangles() const;
+		int getNumMeshes() const;
+		int getNumInstances() const;
+		int getNumInstancedMeshes() const;
 		int getNumLights() const;
 		int getNumDirectionalLights() const;
 		int getNumPointLights() const;
+		double getParseTimeInSeconds() const;
+		double getBuildTimeInSeconds() const;
 		bool loaded() const;
 		glm::vec3 attenuation;
 		int maxDepth;
 		Color backgroundColor;
-		Intersection findClosestIntersection(const Ray& ray) const;
+		Intersection findClosestIntersection(const Ray& ray, TraversalStats& stats) const;
+		bool isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const;
+		//Packet versions of the two queries, see AccelerationStructure
+		void findClosestIntersections(const std::vector<Ray>& rays, Intersection* closest, TraversalStats& stats) const;
+		void findOccluded(const std::vector<Ray>& rays, const float* maxDistances, bool* occluded, TraversalStats& stats) const;
 
 	private:
-		Partition* objectTree;
+		AccelerationStructure* objectTree = nullptr;
 		Camera cam;
 		bool isLoaded;
 		std::vector<Light> lights;
 		unsigned int width, height;
 		std::string outputFileName;
-		std::vector<Shape*> objects;
-		int numTriangles, numPointLights, numDirectionalLights, numSpheres;
+		Primitives primitives;
+		//Shared by every triangle in a mesh
+		std::vector<TriangleMesh*> meshes;
+		//Shared by every instance of a mesh
+		std::vector<InstancedMesh*> instancedMeshes;
+		//Triangles in a row that share a material, transform and kind of
+		//vertex, as scene vertex indices. Turned into meshes once the whole
+		//file is read, when it's known which ones repeat.
+		struct MeshBlock {
+			uint32_t materialIndex;
+			bool withNormals;
+			glm::mat4 transform;
+			std::vector<int> vertices;
+		};
+		void addMeshes(const std::vector<MeshBlock>& blocks, const glm::vec3* verts, const glm::vec3* vertNorms, bool instanceMeshes);
+		//Each distinct material once, shapes and hits refer to them by index
+		std::vector<Material> materials;
+		uint32_t findOrAddMaterial(const Material& mat);
+		//Fills in the normal and material of a hit found by objectTree
+		void completeIntersection(const Ray& ray, Intersection& hit) const;
+		int numTriangles = 0, numPointLights = 0, numDirectionalLights = 0, numSpheres = 0;
+		double parseTimeInSeconds = 0.0;
+		double buildTimeInSeconds = 0.0;
 };
 
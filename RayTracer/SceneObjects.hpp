@@ -4,13 +4,39 @@
 #include <limits>
 #include <cmath>
 #include <algorithm>
+#include <utility>
+#include <cstdint>
 #include "Color.h"
 #include <string>
 
+//dir should be unit length so distances along the ray are world space distances
 struct Ray {
-	Ray(const glm::vec3& org, const glm::vec3& dir) : origin(org), dir(dir) {}
+	Ray(const glm::vec3& org, const glm::vec3& dir) : origin(org), dir(dir) {
+		//Per ray setup for the watertight triangle test (Woop et al. 2013).
+		//kz is the dominant axis of dir, the shear maps dir onto it.
+		glm::vec3 absDir = glm::abs(dir);
+		kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+		kx = (kz + 1) % 3;
+		ky = (kx + 1) % 3;
+		//Swap to keep the winding of the triangle
+		if (dir[kz] < 0.0f) {
+			std::swap(kx, ky);
+		}
+		shear = glm::vec3(dir[kx] / dir[kz], dir[ky] / dir[kz], 1.0f / dir[kz]);
+		//Per ray setup for the slab test, near zero components are nudged
+		//so box distances stay finite
+		for (int i = 0; i < 3; ++i) {
+			invDir[i] = 1.0f / (glm::epsilonEqual(dir[i], 0.0f, 0.00001f) ? 0.00001f : dir[i]);
+			sign[i] = invDir[i] < 0.0f;
+		}
+	}
 	glm::vec3 dir;
 	glm::vec3 origin;
+	int kx, ky, kz;
+	glm::vec3 shear;
+	glm::vec3 invDir;
+	//1 where the direction is negative, so the ray meets the max side of a box first
+	int sign[3];
 };
 
 struct Material {
@@ -19,24 +45,38 @@ struct Material {
 	Material(const Color& diffuse, const Color& specular, const Color& emission, const Color& ambient, float shininess): diffuse(diffuse), specular(specular), emission(emission), ambient(ambient), shininess(shininess){}
 	Material(const Color& diffuse): diffuse(diffuse){}
 	Material(){}
+	bool operator==(const Material& other) const {
+		return diffuse == other.diffuse && specular == other.specular && emission == other.emission && ambient == other.ambient && shininess == other.shininess;
+	}
 };
 
 struct Light {
 	glm::vec4 location;
 	Color color;
-	bool isPointLight() { return location.w > 0.0f; }
+	bool isPointLight() const { return location.w > 0.0f; }
 	Light(const glm::vec4& location, const Color& color) : location(location), color(color){}
 };
 
+//Traversal only fills in the distance, object and barycentrics. The normal
+//and material are worked out once the closest hit is known.
 struct Intersection {
 	float distAlongRay = std::numeric_limits<float>::infinity();
-	Material mat;
+	//Index of the hit object in the scene
+	uint32_t objectIndex = 0;
+	//Instance hits only: index of the triangle hit in the instanced mesh
+	uint32_t instancedObjectIndex = 0;
+	//Triangle hits only: weights of the second and third vertex at the hit point
+	glm::vec2 barycentrics;
+	//Index into the scene's material table
+	uint32_t materialIndex = 0;
+	//Unit length shading normal
 	glm::vec3 intersectNormal;
 	bool isValidIntersection() const {
 		return !glm::isinf(distAlongRay);
 	}
 	Intersection(float distAlongRay): distAlongRay(distAlongRay){}
 	Intersection(float distAlongRay, const glm::vec3& normal) : distAlongRay(distAlongRay), intersectNormal(glm::normalize(normal)) {}
+	Intersection(float distAlongRay, const glm::vec2& barycentrics) : distAlongRay(distAlongRay), barycentrics(barycentrics) {}
 	Intersection(){}
 };
 
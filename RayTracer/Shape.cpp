@@ -1,10 +1,6 @@
 #include "Shape.h"
 #include "AABB.h"
 
-Shape::Shape(const glm::mat4& transform, const Material& mat): transform(transform), material(mat)
-{
-}
-
 Shape::Shape() {
 
 }
@@ -45,6 +41,6 @@ Intersection Shape::intersect(const Ray& ray) const {
 	return Intersection();
 }
 
-const Material& Shape::getMaterial() const {
-	return material;
+uint32_t Shape::getMaterialIndex() const {
+	return 0;
 }
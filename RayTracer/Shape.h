@@ -8,7 +8,6 @@ class AABB;
 class Shape
 {
 public:
-	Shape(const glm::mat4& transform, const Material& mat);
 	Shape();
 	virtual ~Shape();
 	virtual float getMinX() const;
@@ -19,10 +18,8 @@ public:
 	virtual float getMaxZ() const;
 	virtual bool isInside(const AABB& box) const;
 	virtual Intersection intersect(const Ray& ray) const;
-	const Material& getMaterial() const;
-
-protected:
-	glm::mat4 transform;
-	const Material material;
+	//Unit length normal at point, where hit found by intersect lies
+	virtual glm::vec3 getNormal(const glm::vec3& point, const Intersection& hit) const = 0;
+	virtual uint32_t getMaterialIndex() const;
 };
 
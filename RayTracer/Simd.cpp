@@ -0,0 +1,220 @@
+#include "Simd.h"
+#include "CpuFeatures.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define RAYTRACER_SSE2
+#endif
+
+// Every backend is compiled for its instruction set on its own and only called
+// when the CPU has it, so the rest of the program still runs on older
+// machines. GCC and Clang need the instruction set turned on around the code
+// using it, MSVC lets any function use any intrinsic.
+#if defined(RAYTRACER_SSE2) && (defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__))
+#define RAYTRACER_AVX2
+#define RAYTRACER_AVX512
+#endif
+#define RAYTRACER_PRAGMA(...) _Pragma(#__VA_ARGS__)
+#if defined(__clang__)
+#define RAYTRACER_BEGIN_TARGET(isa) RAYTRACER_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define RAYTRACER_END_TARGET RAYTRACER_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define RAYTRACER_BEGIN_TARGET(isa) RAYTRACER_PRAGMA(GCC push_options) RAYTRACER_PRAGMA(GCC target(isa))
+#define RAYTRACER_END_TARGET RAYTRACER_PRAGMA(GCC pop_options)
+#else
+#define RAYTRACER_BEGIN_TARGET(isa)
+#define RAYTRACER_END_TARGET
+#endif
+
+// Each backend defines Float, a vector of Float::width floats, and Mask, the
+// result of comparing two of them, then includes the kernels written against
+// them. None of the operations are fused, so every backend gives the same
+// results as the scalar code.
+
+#ifdef RAYTRACER_SSE2
+namespace {
+	namespace sse2 {
+		struct Mask {
+			__m128 value;
+			int bits() const {
+				return _mm_movemask_ps(value);
+			}
+		};
+		inline Mask operator&(Mask a, Mask b) { return Mask{ _mm_and_ps(a.value, b.value) }; }
+		inline Mask operator|(Mask a, Mask b) { return Mask{ _mm_or_ps(a.value, b.value) }; }
+		//Lanes set in a but not in b
+		inline Mask andNot(Mask a, Mask b) { return Mask{ _mm_andnot_ps(b.value, a.value) }; }
+
+		struct Float {
+			static const int width = 4;
+			__m128 value;
+			Float() {}
+			Float(__m128 value) : value(value) {}
+			explicit Float(float scalar) : value(_mm_set1_ps(scalar)) {}
+			static Float load(const float* source) {
+				return _mm_loadu_ps(source);
+			}
+			void store(float* destination) const {
+				_mm_storeu_ps(destination, value);
+			}
+		};
+		inline Float operator+(Float a, Float b) { return _mm_add_ps(a.value, b.value); }
+		inline Float operator-(Float a, Float b) { return _mm_sub_ps(a.value, b.value); }
+		inline Float operator*(Float a, Float b) { return _mm_mul_ps(a.value, b.value); }
+		inline Float operator/(Float a, Float b) { return _mm_div_ps(a.value, b.value); }
+		inline Float operator-(Float a) { return _mm_xor_ps(a.value, _mm_set1_ps(-0.0f)); }
+		inline Float min(Float a, Float b) { return _mm_min_ps(a.value, b.value); }
+		inline Float max(Float a, Float b) { return _mm_max_ps(a.value, b.value); }
+		inline Float sqrt(Float a) { return _mm_sqrt_ps(a.value); }
+		inline Mask operator<(Float a, Float b) { return Mask{ _mm_cmplt_ps(a.value, b.value) }; }
+		inline Mask operator<=(Float a, Float b) { return Mask{ _mm_cmple_ps(a.value, b.value) }; }
+		inline Mask operator>(Float a, Float b) { return Mask{ _mm_cmpgt_ps(a.value, b.value) }; }
+		inline Mask operator>=(Float a, Float b) { return Mask{ _mm_cmpge_ps(a.value, b.value) }; }
+		inline Mask operator==(Float a, Float b) { return Mask{ _mm_cmpeq_ps(a.value, b.value) }; }
+		inline Mask operator!=(Float a, Float b) { return Mask{ _mm_cmpneq_ps(a.value, b.value) }; }
+		//a in the lanes set in mask, b in the rest
+		inline Float select(Mask mask, Float a, Float b) {
+			return _mm_or_ps(_mm_and_ps(mask.value, a.value), _mm_andnot_ps(mask.value, b.value));
+		}
+#include "SimdKernels.inl"
+	}
+}
+#endif
+
+#ifdef RAYTRACER_AVX2
+RAYTRACER_BEGIN_TARGET("avx2")
+namespace {
+	namespace avx2 {
+		struct Mask {
+			__m256 value;
+			int bits() const {
+				return _mm256_movemask_ps(value);
+			}
+		};
+		inline Mask operator&(Mask a, Mask b) { return Mask{ _mm256_and_ps(a.value, b.value) }; }
+		inline Mask operator|(Mask a, Mask b) { return Mask{ _mm256_or_ps(a.value, b.value) }; }
+		inline Mask andNot(Mask a, Mask b) { return Mask{ _mm256_andnot_ps(b.value, a.value) }; }
+
+		struct Float {
+			static const int width = 8;
+			__m256 value;
+			Float() {}
+			Float(__m256 value) : value(value) {}
+			explicit Float(float scalar) : value(_mm256_set1_ps(scalar)) {}
+			static Float load(const float* source) {
+				return _mm256_loadu_ps(source);
+			}
+			void store(float* destination) const {
+				_mm256_storeu_ps(destination, value);
+			}
+		};
+		inline Float operator+(Float a, Float b) { return _mm256_add_ps(a.value, b.value); }
+		inline Float operator-(Float a, Float b) { return _mm256_sub_ps(a.value, b.value); }
+		inline Float operator*(Float a, Float b) { return _mm256_mul_ps(a.value, b.value); }
+		inline Float operator/(Float a, Float b) { return _mm256_div_ps(a.value, b.value); }
+		inline Float operator-(Float a) { return _mm256_xor_ps(a.value, _mm256_set1_ps(-0.0f)); }
+		inline Float min(Float a, Float b) { return _mm256_min_ps(a.value, b.value); }
+		inline Float max(Float a, Float b) { return _mm256_max_ps(a.value, b.value); }
+		inline Float sqrt(Float a) { return _mm256_sqrt_ps(a.value); }
+		inline Mask operator<(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_LT_OQ) }; }
+		inline Mask operator<=(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_LE_OQ) }; }
+		inline Mask operator>(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_GT_OQ) }; }
+		inline Mask operator>=(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_GE_OQ) }; }
+		inline Mask operator==(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_EQ_OQ) }; }
+		inline Mask operator!=(Float a, Float b) { return Mask{ _mm256_cmp_ps(a.value, b.value, _CMP_NEQ_UQ) }; }
+		inline Float select(Mask mask, Float a, Float b) {
+			return _mm256_blendv_ps(b.value, a.value, mask.value);
+		}
+#include "SimdKernels.inl"
+	}
+}
+RAYTRACER_END_TARGET
+#endif
+
+// Leaves and wide nodes hold at most 8 things, so AVX-512 is used at 256 bits
+// (AVX-512VL). Comparisons go straight to mask registers instead of vectors
+// that have to be combined and then moved out.
+#ifdef RAYTRACER_AVX512
+RAYTRACER_BEGIN_TARGET("avx512f,avx512vl")
+namespace {
+	namespace avx512 {
+		struct Mask {
+			__mmask8 value;
+			int bits() const {
+				return value;
+			}
+		};
+		inline Mask operator&(Mask a, Mask b) { return Mask{ static_cast<__mmask8>(a.value & b.value) }; }
+		inline Mask operator|(Mask a, Mask b) { return Mask{ static_cast<__mmask8>(a.value | b.value) }; }
+		inline Mask andNot(Mask a, Mask b) { return Mask{ static_cast<__mmask8>(a.value & ~b.value) }; }
+
+		struct Float {
+			static const int width = 8;
+			__m256 value;
+			Float() {}
+			Float(__m256 value) : value(value) {}
+			explicit Float(float scalar) : value(_mm256_set1_ps(scalar)) {}
+			static Float load(const float* source) {
+				return _mm256_loadu_ps(source);
+			}
+			void store(float* destination) const {
+				_mm256_storeu_ps(destination, value);
+			}
+		};
+		inline Float operator+(Float a, Float b) { return _mm256_add_ps(a.value, b.value); }
+		inline Float operator-(Float a, Float b) { return _mm256_sub_ps(a.value, b.value); }
+		inline Float operator*(Float a, Float b) { return _mm256_mul_ps(a.value, b.value); }
+		inline Float operator/(Float a, Float b) { return _mm256_div_ps(a.value, b.value); }
+		inline Float operator-(Float a) { return _mm256_xor_ps(a.value, _mm256_set1_ps(-0.0f)); }
+		inline Float min(Float a, Float b) { return _mm256_min_ps(a.value, b.value); }
+		inline Float max(Float a, Float b) { return _mm256_max_ps(a.value, b.value); }
+		inline Float sqrt(Float a) { return _mm256_sqrt_ps(a.value); }
+		inline Mask operator<(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_LT_OQ) }; }
+		inline Mask operator<=(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_LE_OQ) }; }
+		inline Mask operator>(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_GT_OQ) }; }
+		inline Mask operator>=(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_GE_OQ) }; }
+		inline Mask operator==(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_EQ_OQ) }; }
+		inline Mask operator!=(Float a, Float b) { return Mask{ _mm256_cmp_ps_mask(a.value, b.value, _CMP_NEQ_UQ) }; }
+		inline Float select(Mask mask, Float a, Float b) {
+			return _mm256_mask_blend_ps(mask.value, b.value, a.value);
+		}
+#include "SimdKernels.inl"
+	}
+}
+RAYTRACER_END_TARGET
+#endif
+
+// Boxes of 4 children are always tested with SSE2, the wider backends only
+// come in for 8.
+SimdKernels::SimdKernels() {
+	const CpuFeatures& cpu = CpuFeatures::get();
+#ifdef RAYTRACER_SSE2
+	if (cpu.sse2) {
+		intersectBoxes4 = sse2::intersectBoxes<4>;
+		intersectBoxes8 = sse2::intersectBoxes<8>;
+		intersectTriangles = sse2::intersectTriangles;
+		intersectSpheres = sse2::intersectSpheres;
+		name = "sse2";
+	}
+#endif
+#ifdef RAYTRACER_AVX2
+	if (cpu.avx2) {
+		intersectBoxes8 = avx2::intersectBoxes<8>;
+		intersectTriangles = avx2::intersectTriangles;
+		intersectSpheres = avx2::intersectSpheres;
+		name = "avx2";
+	}
+#endif
+#ifdef RAYTRACER_AVX512
+	if (cpu.avx512) {
+		intersectBoxes8 = avx512::intersectBoxes<8>;
+		intersectTriangles = avx512::intersectTriangles;
+		intersectSpheres = avx512::intersectSpheres;
+		name = "avx512";
+	}
+#endif
+}
+
+const SimdKernels& SimdKernels::get() {
+	static const SimdKernels kernels;
+	return kernels;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "SceneObjects.hpp"
+#include "TriangleBlock.h"
+#include "SphereBlock.h"
+
+//Box, triangle and sphere tests written once in SimdKernels.inl against a
+//small vector type, and compiled for SSE2, AVX2 and AVX-512. get() picks the
+//widest instruction set the CPU supports when the program starts.
+struct SimdKernels {
+	//bounds rows are minX, minY, minZ, maxX, maxY, maxZ of Width boxes. Bit i
+	//of the result is set when box i is entered before maxDistance, and
+	//entryDistances[i] is where.
+	template<int Width>
+	using BoxKernel = int (*)(const float (*bounds)[Width], const Ray& ray, float maxDistance, float* entryDistances);
+	//Tests the ray against the lanes in laneMask and returns the ones hit
+	//before maxDistance, filling in their entries of hits. Lanes hit exactly
+	//on an edge are returned in edgeMask instead and need the scalar test.
+	typedef int (*TriangleKernel)(const TriangleBlock& block, const Ray& ray, int laneMask, float maxDistance, TriangleBlock::Hits& hits, int& edgeMask);
+	//Same for spheres, distances gets the distance of each lane hit
+	typedef int (*SphereKernel)(const SphereBlock& block, const Ray& ray, int laneMask, float maxDistance, float* distances);
+
+	//All nullptr when the CPU has none of the instruction sets
+	BoxKernel<4> intersectBoxes4 = nullptr;
+	BoxKernel<8> intersectBoxes8 = nullptr;
+	TriangleKernel intersectTriangles = nullptr;
+	SphereKernel intersectSpheres = nullptr;
+	const char* name = "scalar";
+
+	template<int Width>
+	BoxKernel<Width> getBoxKernel() const;
+	static const SimdKernels& get();
+
+	private:
+		SimdKernels();
+};
+
+template<>
+inline SimdKernels::BoxKernel<4> SimdKernels::getBoxKernel<4>() const {
+	return intersectBoxes4;
+}
+
+template<>
+inline SimdKernels::BoxKernel<8> SimdKernels::getBoxKernel<8>() const {
+	return intersectBoxes8;
+}
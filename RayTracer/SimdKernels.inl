@@ -0,0 +1,89 @@
+// Kernels shared by every backend in Simd.cpp, included once inside each
+// backend's namespace after its Float and Mask. Deliberately has no include
+// guard.
+
+// Same slab test as AABB::intersectInterval, Float::width boxes at a time
+template<int Width>
+int intersectBoxes(const float (*bounds)[Width], const Ray& ray, float maxDistance, float* entryDistances) {
+	static_assert(Width % Float::width == 0, "Boxes must fill whole vectors");
+	int hitMask = 0;
+	for (int first = 0; first < Width; first += Float::width) {
+		Float tmin(0.0f);
+		Float tmax(maxDistance);
+		for (int axis = 0; axis < 3; ++axis) {
+			Float origin(ray.origin[axis]);
+			Float invDir(ray.invDir[axis]);
+			Float nearPlane = Float::load(bounds[axis + 3 * ray.sign[axis]] + first);
+			Float farPlane = Float::load(bounds[axis + 3 * (1 - ray.sign[axis])] + first);
+			tmin = max(tmin, (nearPlane - origin) * invDir);
+			tmax = min(tmax, (farPlane - origin) * invDir);
+		}
+		tmin.store(entryDistances + first);
+		hitMask |= (tmin <= tmax).bits() << first;
+	}
+	return hitMask;
+}
+
+// The watertight test in TriangleMesh::intersect with the operations done in
+// the same order, so it gives the same distances
+int intersectTriangles(const TriangleBlock& block, const Ray& ray, int laneMask, float maxDistance, TriangleBlock::Hits& hits, int& edgeMask) {
+	const Float zero(0.0f);
+	const Float originX(ray.origin[ray.kx]);
+	const Float originY(ray.origin[ray.ky]);
+	const Float originZ(ray.origin[ray.kz]);
+	const Float shearX(ray.shear.x);
+	const Float shearY(ray.shear.y);
+	const Float shearZ(ray.shear.z);
+	int hitMask = 0;
+	edgeMask = 0;
+	for (int first = 0; first < TriangleBlock::width; first += Float::width) {
+		Float x[3], y[3], z[3];
+		for (int vertex = 0; vertex < 3; ++vertex) {
+			Float relZ = Float::load(block.vertices[3 * vertex + ray.kz] + first) - originZ;
+			x[vertex] = (Float::load(block.vertices[3 * vertex + ray.kx] + first) - originX) - shearX * relZ;
+			y[vertex] = (Float::load(block.vertices[3 * vertex + ray.ky] + first) - originY) - shearY * relZ;
+			z[vertex] = shearZ * relZ;
+		}
+		Float u = x[2] * y[1] - y[2] * x[1];
+		Float v = x[0] * y[2] - y[0] * x[2];
+		Float w = x[1] * y[0] - y[1] * x[0];
+		Mask onEdge = (u == zero) | (v == zero) | (w == zero);
+		Mask anyNegative = (u < zero) | (v < zero) | (w < zero);
+		Mask anyPositive = (u > zero) | (v > zero) | (w > zero);
+		Float det = (u + v) + w;
+		Float t = ((u * z[0] + v * z[1]) + w * z[2]) / det;
+		Mask hit = andNot(det != zero, anyNegative & anyPositive) & (t >= Float(0.0001f)) & (t < Float(maxDistance));
+		t.store(hits.distances + first);
+		(v / det).store(hits.v + first);
+		(w / det).store(hits.w + first);
+		int edgeLanes = onEdge.bits();
+		edgeMask |= edgeLanes << first;
+		hitMask |= (hit.bits() & ~edgeLanes) << first;
+	}
+	edgeMask &= laneMask;
+	return hitMask & laneMask;
+}
+
+// Sphere::intersectWorldSpace with the operations done in the same order. The
+// far root is taken in lanes where the near one is behind the ray.
+int intersectSpheres(const SphereBlock& block, const Ray& ray, int laneMask, float maxDistance, float* distances) {
+	const Float zero(0.0f);
+	const Float minDistance(0.001f);
+	int hitMask = 0;
+	for (int first = 0; first < SphereBlock::width; first += Float::width) {
+		Float toOriginX = Float(ray.origin.x) - Float::load(block.centers[0] + first);
+		Float toOriginY = Float(ray.origin.y) - Float::load(block.centers[1] + first);
+		Float toOriginZ = Float(ray.origin.z) - Float::load(block.centers[2] + first);
+		Float radius = Float::load(block.radii + first);
+		Float b = (Float(ray.dir.x) * toOriginX + Float(ray.dir.y) * toOriginY) + Float(ray.dir.z) * toOriginZ;
+		Float c = ((toOriginX * toOriginX + toOriginY * toOriginY) + toOriginZ * toOriginZ) - radius * radius;
+		Float discrim = b * b - c;
+		Float root = sqrt(discrim);
+		Float nearT = -b - root;
+		Float t = select(nearT < minDistance, -b + root, nearT);
+		Mask hit = (discrim >= zero) & (t >= minDistance) & (t < Float(maxDistance));
+		t.store(distances + first);
+		hitMask |= hit.bits() << first;
+	}
+	return hitMask & laneMask;
+}
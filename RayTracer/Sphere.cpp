@@ -1,48 +1,79 @@
 #include "Sphere.h"
 #include <algorithm>
 #include "AABB.h"
+#include <glm/gtc/epsilon.hpp>
 
-Sphere::Sphere(const glm::vec3& center, float radius, const glm::mat4& transform, const Material& mat): Shape(transform, mat), center(center), radius(radius){
+Sphere::Sphere(const glm::vec3& center, float radius, const glm::mat4& transform, uint32_t materialIndex): center(center), radius(radius), transform(transform), materialIndex(materialIndex){
+	inverseTransform = glm::inverse(transform);
+	normalTransform = glm::transpose(glm::mat3(inverseTransform));
+	worldCenter = transform * glm::vec4(center, 1.0f);
 
+	// Half size of the box around the transformed sphere (an ellipsoid).
+	// Each world axis extends by the radius times the length of the
+	// corresponding row of the upper 3x3 of the transform.
+	for (int i = 0; i < 3; ++i) {
+		worldExtent[i] = radius * glm::length(glm::vec3(transform[0][i], transform[1][i], transform[2][i]));
+	}
+
+	float scale = transform[0][0];
+	glm::mat3 linear(transform);
+	glm::mat3 uniformScale(scale);
+	isWorldSpaceSphere = transform[0][3] == 0.0f && transform[1][3] == 0.0f && transform[2][3] == 0.0f && transform[3][3] == 1.0f;
+	for (int col = 0; col < 3; ++col) {
+		for (int row = 0; row < 3; ++row) {
+			isWorldSpaceSphere = isWorldSpaceSphere && glm::epsilonEqual(linear[col][row], uniformScale[col][row], 0.00001f);
+		}
+	}
+	worldRadius = radius * std::abs(scale);
 }
 
 Sphere::~Sphere()
 {
 }
 
+uint32_t Sphere::getMaterialIndex() const {
+	return materialIndex;
+}
+
+bool Sphere::isWorldSpace() const {
+	return isWorldSpaceSphere;
+}
+
+glm::vec3 Sphere::getWorldCenter() const {
+	return worldCenter;
+}
+
+float Sphere::getWorldRadius() const {
+	return worldRadius;
+}
+
 float Sphere::getMinX() const {
-	float x = (transform * glm::vec4(center.x - radius, 0.0f, 0.0f, 1.0f)).x;
-	return x;
+	return worldCenter.x - worldExtent.x;
 }
 
 float Sphere::getMinY() const {
-	float y = (transform * glm::vec4(0.0f, center.y - radius, 0.0f, 1.0f)).y;
-	return y;
+	return worldCenter.y - worldExtent.y;
 }
 
 float Sphere::getMinZ() const {
-	float z = (transform * glm::vec4(0.0f, 0.0f, center.z -radius, 1.0f)).z;
-	return z;
+	return worldCenter.z - worldExtent.z;
 }
 
 float Sphere::getMaxX() const {
-	float x = (transform * glm::vec4(center.x + radius, 0.0f, 0.0f, 1.0f)).x;
-	return x;
+	return worldCenter.x + worldExtent.x;
 }
 
 float Sphere::getMaxY() const {
-	float y = (transform * glm::vec4(0.0f, center.y + radius, 0.0f, 1.0f)).y;
-	return y;
+	return worldCenter.y + worldExtent.y;
 }
 
 float Sphere::getMaxZ() const {
-	float z = (transform * glm::vec4(0.0f, 0.0f, center.z + radius, 1.0f)).z;
-	return z;
+	return worldCenter.z + worldExtent.z;
 }
 
 bool Sphere::isInside(const AABB& box) const {
-	glm::vec3 boxMin = glm::inverse(transform)*glm::vec4(box.getMin(), 1.0f);
-	glm::vec3 boxMax = glm::inverse(transform)*glm::vec4(box.getMax(), 1.0f);
+	glm::vec3 boxMin = inverseTransform*glm::vec4(box.getMin(), 1.0f);
+	glm::vec3 boxMax = inverseTransform*glm::vec4(box.getMax(), 1.0f);
 	float x = std::max(boxMin.x, std::min(center.x, boxMax.x));
 	float y = std::max(boxMin.y, std::min(center.y, boxMax.y));
 	float z = std::max(boxMin.z, std::min(center.z, boxMax.z));
@@ -56,12 +87,41 @@ bool Sphere::isInside(const AABB& box) const {
 	return box.contains(center) || distance < radius;
 }
 
-Intersection Sphere::intersect(const Ray& rawRay) const {
-	Ray ray(glm::inverse(transform) * glm::vec4(rawRay.origin, 1.0f), glm::normalize(glm::inverse(transform) * glm::vec4(rawRay.dir, 0.0f)));
-	glm::vec3 normalRayDir = glm::normalize(ray.dir);
-	float a = glm::dot(normalRayDir, normalRayDir);
-	float b = 2.0f * glm::dot(normalRayDir, (ray.origin - center));
-	float c = glm::dot((ray.origin - center), (ray.origin - center)) - glm::pow(radius, 2.0f);
+Intersection Sphere::intersect(const Ray& ray) const {
+	if (isWorldSpaceSphere) {
+		return intersectWorldSpace(ray);
+	}
+	return intersectObjectSpace(ray);
+}
+
+// Ray direction is unit length so the quadratic's a term is 1
+Intersection Sphere::intersectWorldSpace(const Ray& ray) const {
+	glm::vec3 toOrigin = ray.origin - worldCenter;
+	float b = glm::dot(ray.dir, toOrigin);
+	float c = glm::dot(toOrigin, toOrigin) - worldRadius * worldRadius;
+	float discrim = b * b - c;
+	if (discrim < 0.0f) {
+		return Intersection();
+	}
+	float root = glm::sqrt(discrim);
+	float t = -b - root;
+	if (t < 0.001f) {
+		t = -b + root;
+		if (t < 0.001f) {
+			return Intersection();
+		}
+	}
+	return Intersection(t);
+}
+
+// Ellipsoids are intersected as the untransformed sphere using the ray
+// moved into object space
+Intersection Sphere::intersectObjectSpace(const Ray& rawRay) const {
+	glm::vec3 origin = inverseTransform * glm::vec4(rawRay.origin, 1.0f);
+	glm::vec3 dir = glm::normalize(glm::vec3(inverseTransform * glm::vec4(rawRay.dir, 0.0f)));
+	float a = glm::dot(dir, dir);
+	float b = 2.0f * glm::dot(dir, (origin - center));
+	float c = glm::dot((origin - center), (origin - center)) - radius * radius;
 	float discrim = calculateDiscriminant(a, b, c);
 	if (discrim < 0.0f) {
 		return Intersection();
@@ -75,11 +135,17 @@ Intersection Sphere::intersect(const Ray& rawRay) const {
 			return Intersection();
 		}
 	}
-	glm::vec3 transfPoint = ray.origin + ray.dir * t;
-	glm::vec3 normal = glm::transpose(glm::inverse(transform)) * glm::vec4(2.0f*(transfPoint - center), 0.0f);
-
+	glm::vec3 transfPoint = origin + dir * t;
 	glm::vec3 finalPoint = transform * glm::vec4(transfPoint, 1.0f);
-	return Intersection(glm::distance(finalPoint, rawRay.origin), normal);
+	return Intersection(glm::distance(finalPoint, rawRay.origin));
+}
+
+glm::vec3 Sphere::getNormal(const glm::vec3& point, const Intersection& /*hit*/) const {
+	if (isWorldSpaceSphere) {
+		return glm::normalize((point - worldCenter) / worldRadius);
+	}
+	glm::vec3 transfPoint = inverseTransform * glm::vec4(point, 1.0f);
+	return glm::normalize(normalTransform * (transfPoint - center));
 }
 
 float Sphere::calculateDiscriminant(float a, float b, float c) const {
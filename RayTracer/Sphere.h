@@ -1,11 +1,11 @@
 #pragma once
 #include "Shape.h"
 
-class Sphere :
+class Sphere final :
 	public Shape
 {
 public:
-	Sphere(const glm::vec3& center, float radius, const glm::mat4& transform, const Material& mat);
+	Sphere(const glm::vec3& center, float radius, const glm::mat4& transform, uint32_t materialIndex);
 	virtual ~Sphere();
 	virtual float getMinX() const override;
 	virtual float getMinY() const override;
@@ -15,10 +15,29 @@ public:
 	virtual float getMaxZ() const override;
 	virtual bool isInside(const AABB& box) const override;
 	virtual Intersection intersect(const Ray& ray) const override;
+	virtual glm::vec3 getNormal(const glm::vec3& point, const Intersection& hit) const override;
+	virtual uint32_t getMaterialIndex() const override;
+	//Spheres still spheres in world space, which SphereBlock can hold
+	bool isWorldSpace() const;
+	glm::vec3 getWorldCenter() const;
+	float getWorldRadius() const;
 
 private:
 	const glm::vec3 center;
 	float radius;
+	glm::mat4 transform;
+	uint32_t materialIndex;
+	//Object space matrices, computed once at construction
+	glm::mat4 inverseTransform;
+	glm::mat3 normalTransform;
+	//Spheres only translated and uniformly scaled stay spheres, so they are
+	//intersected directly in world space
+	bool isWorldSpaceSphere;
+	glm::vec3 worldCenter;
+	float worldRadius;
+	glm::vec3 worldExtent;
 	float calculateDiscriminant(float a, float b, float c) const;
+	Intersection intersectWorldSpace(const Ray& ray) const;
+	Intersection intersectObjectSpace(const Ray& ray) const;
 };
 
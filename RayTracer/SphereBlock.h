@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+//Up to 8 world space spheres of one leaf stored a coordinate per row, tested
+//together like TriangleBlock. Ellipsoids are still tested one at a time.
+struct SphereBlock {
+	static const int width = 8;
+	float centers[3][width];
+	float radii[width];
+	//Scene wide object index of each lane
+	uint32_t objects[width];
+	//Lanes holding a sphere, unused lanes repeat the last one
+	int laneMask;
+};
@@ -0,0 +1,174 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+
+namespace {
+	//Set on worker threads to their scheduler and index into its queues
+	thread_local const TaskScheduler* currentScheduler = nullptr;
+	thread_local unsigned int currentWorker = 0;
+	//Workers get() starts with, 0 for one per hardware thread
+	unsigned int configuredWorkers = 0;
+}
+
+TaskScheduler::TaskGroup::TaskGroup(TaskScheduler& scheduler) : scheduler(scheduler), pending(0) {
+}
+
+TaskScheduler::TaskGroup::~TaskGroup() {
+	wait();
+}
+
+void TaskScheduler::TaskGroup::run(std::function<void()> function) {
+	pending++;
+	scheduler.push(Task{ std::move(function), this });
+}
+
+// Runs queued tasks while there are any. They may belong to other groups, but
+// every task finishes eventually so this group does too. With nothing queued
+// the group's last tasks are running elsewhere, so sleep like an idle worker
+// until more tasks are queued or the last one finishes.
+void TaskScheduler::TaskGroup::wait() {
+	while (pending > 0) {
+		Task task;
+		if (scheduler.findTask(task)) {
+			scheduler.runTask(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(scheduler.sleepMutex);
+		scheduler.sleepingWorkers++;
+		scheduler.wakeUp.wait(lock, [this]() { return scheduler.queuedTasks > 0 || pending == 0; });
+		scheduler.sleepingWorkers--;
+	}
+}
+
+bool TaskScheduler::TaskGroup::isDone() const {
+	return pending.load(std::memory_order_acquire) == 0;
+}
+
+TaskScheduler::TaskScheduler(unsigned int numWorkers) : queuedTasks(0), sleepingWorkers(0), stopping(false) {
+	numWorkers = std::max(1u, numWorkers);
+	for (unsigned int i = 0; i <= numWorkers; ++i) {
+		queues.emplace_back(new WorkQueue());
+	}
+	for (unsigned int i = 0; i < numWorkers; ++i) {
+		workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+	}
+}
+
+TaskScheduler::~TaskScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void TaskScheduler::configure(unsigned int numWorkers) {
+	configuredWorkers = numWorkers;
+}
+
+TaskScheduler& TaskScheduler::get() {
+	static TaskScheduler scheduler(configuredWorkers > 0 ? configuredWorkers : std::thread::hardware_concurrency());
+	return scheduler;
+}
+
+unsigned int TaskScheduler::getNumWorkers() const {
+	return workers.size();
+}
+
+unsigned int TaskScheduler::getThreadIndex() const {
+	return currentScheduler == this ? currentWorker : queues.size() - 1;
+}
+
+void TaskScheduler::push(Task task) {
+	// Counted before it is queued so queuedTasks is never too low. Workers
+	// only sleep after seeing no queued tasks, so one that missed this task
+	// is counted in sleepingWorkers and gets woken.
+	queuedTasks++;
+	WorkQueue& queue = *queues[getThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	if (sleepingWorkers > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeUp.notify_one();
+	}
+}
+
+bool TaskScheduler::findTask(Task& task) {
+	if (queuedTasks == 0) {
+		return false;
+	}
+	unsigned int self = getThreadIndex();
+	{
+		WorkQueue& own = *queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queuedTasks--;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); ++i) {
+		WorkQueue& victim = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queuedTasks--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::runTask(Task& task) {
+	task.function();
+	// The group can be destroyed as soon as pending reaches 0, so it isn't
+	// touched after this. A thread waiting on it is counted in sleepingWorkers
+	// before it last checks pending, the same as for queued tasks in push.
+	if (--task.group->pending == 0 && sleepingWorkers > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeUp.notify_all();
+	}
+}
+
+void TaskScheduler::workerLoop(unsigned int index) {
+	currentScheduler = this;
+	currentWorker = index;
+	while (!stopping) {
+		Task task;
+		if (findTask(task)) {
+			runTask(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers++;
+		wakeUp.wait(lock, [this]() { return queuedTasks > 0 || stopping; });
+		sleepingWorkers--;
+	}
+}
+
+void TaskScheduler::parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t first, size_t last)>& body) {
+	TaskGroup group(*this);
+	splitRange(group, begin, end, std::max<size_t>(1, grainSize), body);
+	group.wait();
+}
+
+// The second half is left for thieves while this thread goes on splitting
+// the first, so each steal takes the largest piece left
+void TaskScheduler::splitRange(TaskGroup& group, size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body) {
+	while (end - begin > grainSize) {
+		size_t middle = begin + (end - begin) / 2;
+		group.run([this, &group, middle, end, grainSize, &body]() {
+			splitRange(group, middle, end, grainSize, body);
+		});
+		end = middle;
+	}
+	if (begin < end) {
+		body(begin, end);
+	}
+}
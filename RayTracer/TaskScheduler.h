@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//Work stealing thread pool shared by tree building and rendering. Every
+//worker has its own queue: it runs its newest task first, and idle workers
+//steal the oldest task from another queue. Tasks forked by a recursive job
+//stay on the thread that made them unless another thread runs out of work.
+class TaskScheduler {
+	public:
+		//Tasks run together and are joined with wait(). Threads waiting on a
+		//group run other tasks meanwhile, so tasks can fork and join groups
+		//of their own without tying up workers. With nothing left to run
+		//they sleep until the group finishes.
+		class TaskGroup {
+			public:
+				TaskGroup(TaskScheduler& scheduler = TaskScheduler::get());
+				//Waits for any tasks still running
+				~TaskGroup();
+				void run(std::function<void()> function);
+				void wait();
+				//True once every task run so far has finished
+				bool isDone() const;
+
+			private:
+				TaskScheduler& scheduler;
+				std::atomic<int> pending;
+				friend class TaskScheduler;
+		};
+
+		explicit TaskScheduler(unsigned int numWorkers);
+		~TaskScheduler();
+		//Sets the number of workers get() starts with, 0 for one per hardware
+		//thread. Only has an effect before the first call to get().
+		static void configure(unsigned int numWorkers);
+		//Started on first use with the configured number of workers
+		static TaskScheduler& get();
+		unsigned int getNumWorkers() const;
+		//0 to getNumWorkers() - 1 on workers, getNumWorkers() on any other
+		//thread. Lets tasks keep per thread results without locking.
+		unsigned int getThreadIndex() const;
+		//Calls body on pieces [first, last) of [begin, end) at most grainSize
+		//long, splitting the range in half until the pieces are small enough
+		//so thieves take large pieces first. Returns once all are done.
+		void parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t first, size_t last)>& body);
+
+	private:
+		struct Task {
+			std::function<void()> function;
+			TaskGroup* group;
+		};
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+		//One per worker, then one shared by every other thread
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::vector<std::thread> workers;
+		//Tasks in all queues, lets idle workers sleep
+		std::atomic<int> queuedTasks;
+		//Idle workers and threads waiting on a group
+		std::atomic<int> sleepingWorkers;
+		std::mutex sleepMutex;
+		std::condition_variable wakeUp;
+		std::atomic<bool> stopping;
+		void push(Task task);
+		//Own queue newest first, then the other queues oldest first
+		bool findTask(Task& task);
+		void runTask(Task& task);
+		void workerLoop(unsigned int index);
+		void splitRange(TaskGroup& group, size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+};
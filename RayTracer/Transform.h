@@ -1,4 +1,5 @@
 #pragma once
+#include <cmath>
 #include <glm/glm.hpp>
 class Transform {
 public:
@@ -20,7 +21,7 @@ public:
 		float radians = glm::radians(angleInDegrees);
 		glm::vec3 unitAxis = glm::normalize(glm::vec3(x, y, z));
 
-		ret = (cos(radians)* glm::transpose(glm::mat3(1.0f))) + ((1.0f - cos(radians))*glm::transpose(glm::mat3(pow(unitAxis.x, 2.0f), unitAxis.x*unitAxis.y, unitAxis.x*unitAxis.z, unitAxis.x*unitAxis.y, pow(unitAxis.y, 2.0f), unitAxis.y*unitAxis.z, unitAxis.x*unitAxis.z, unitAxis.y*unitAxis.z, pow(unitAxis.z, 2.0f)))) + (sin(radians) * glm::transpose(glm::mat3(0.0f, -unitAxis.z, unitAxis.y, unitAxis.z, 0.0f, -unitAxis.x, -unitAxis.y, unitAxis.x, 0.0f)));
+		ret = (std::cos(radians)* glm::transpose(glm::mat3(1.0f))) + ((1.0f - std::cos(radians))*glm::transpose(glm::mat3(std::pow(unitAxis.x, 2.0f), unitAxis.x*unitAxis.y, unitAxis.x*unitAxis.z, unitAxis.x*unitAxis.y, std::pow(unitAxis.y, 2.0f), unitAxis.y*unitAxis.z, unitAxis.x*unitAxis.z, unitAxis.y*unitAxis.z, std::pow(unitAxis.z, 2.0f)))) + (std::sin(radians) * glm::transpose(glm::mat3(0.0f, -unitAxis.z, unitAxis.y, unitAxis.z, 0.0f, -unitAxis.x, -unitAxis.y, unitAxis.x, 0.0f)));
 		glm::mat4 mat;
 		mat[0] = glm::vec4(ret[0], 0.0f);
 		mat[1] = glm::vec4(ret[1], 0.0f);
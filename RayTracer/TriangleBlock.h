@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+//Up to 8 triangles of one leaf with every vertex coordinate in its own row,
+//so one ray is tested against all of them together with the SimdKernels.
+struct TriangleBlock {
+	static const int width = 8;
+	//Row 3 * vertex + axis holds that coordinate for every lane
+	float vertices[9][width];
+	//Index into Primitives::triangles of each lane
+	uint32_t triangles[width];
+	//Lanes holding a triangle, unused lanes repeat the last one
+	int laneMask;
+
+	struct Hits {
+		float distances[width];
+		//Weights of the second and third vertex
+		float v[width];
+		float w[width];
+	};
+};
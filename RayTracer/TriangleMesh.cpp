@@ -0,0 +1,250 @@
+#include "TriangleMesh.h"
+#include "AABB.h"
+#include <algorithm>
+#include <glm/gtc/epsilon.hpp>
+
+TriangleMesh::TriangleMesh(uint32_t materialIndex) : materialIndex(materialIndex) {
+}
+
+TriangleMesh::~TriangleMesh() {
+}
+
+uint32_t TriangleMesh::addVertex(const glm::vec3& position) {
+	positions.push_back(position);
+	return positions.size() - 1;
+}
+
+uint32_t TriangleMesh::addVertex(const glm::vec3& position, const glm::vec3& normal) {
+	normals.push_back(normal);
+	return addVertex(position);
+}
+
+void TriangleMesh::addTriangle(uint32_t v1, uint32_t v2, uint32_t v3) {
+	indices.push_back(v1);
+	indices.push_back(v2);
+	indices.push_back(v3);
+	planeNormals.push_back(glm::normalize(glm::cross(positions[v2] - positions[v1], positions[v3] - positions[v1])));
+}
+
+uint32_t TriangleMesh::getNumTriangles() const {
+	return planeNormals.size();
+}
+
+bool TriangleMesh::hasNormals() const {
+	return !normals.empty();
+}
+
+uint32_t TriangleMesh::getMaterialIndex() const {
+	return materialIndex;
+}
+
+glm::vec3 TriangleMesh::getVertex(uint32_t triangle, int corner) const {
+	return positions[indices[3 * triangle + corner]];
+}
+
+glm::vec3 TriangleMesh::getMin(uint32_t triangle) const {
+	return glm::min(positions[indices[3 * triangle]], glm::min(positions[indices[3 * triangle + 1]], positions[indices[3 * triangle + 2]]));
+}
+
+glm::vec3 TriangleMesh::getMax(uint32_t triangle) const {
+	return glm::max(positions[indices[3 * triangle]], glm::max(positions[indices[3 * triangle + 1]], positions[indices[3 * triangle + 2]]));
+}
+
+//https://github.com/gszauer/GamePhysicsCookbook/blob/master/Code/Geometry3D.cpp
+bool TriangleMesh::isInside(uint32_t triangle, const AABB& box) const {
+	glm::vec3 v[3] = { positions[indices[3 * triangle]], positions[indices[3 * triangle + 1]], positions[indices[3 * triangle + 2]] };
+	// Compute the edge vectors of the triangle  (ABC)
+	glm::vec3 f0 = v[1] - v[0];
+	glm::vec3 f1 = v[2] - v[1];
+	glm::vec3 f2 = v[0] - v[2];
+
+	// Compute the face normals of the AABB
+	glm::vec3 u0(1.0f, 0.0f, 0.0f);
+	glm::vec3 u1(0.0f, 1.0f, 0.0f);
+	glm::vec3 u2(0.0f, 0.0f, 1.0f);
+
+	glm::vec3 test[13] = {
+		// 3 Normals of AABB
+		u0, // AABB Axis 1
+		u1, // AABB Axis 2
+		u2, // AABB Axis 3
+			// 1 Normal of the Triangle
+			glm::cross(f0, f1),
+			// 9 Axis, cross products of all edges
+			glm::cross(u0, f0),
+			glm::cross(u0, f1),
+			glm::cross(u0, f2),
+			glm::cross(u1, f0),
+			glm::cross(u1, f1),
+			glm::cross(u1, f2),
+			glm::cross(u2, f0),
+			glm::cross(u2, f1),
+			glm::cross(u2, f2)
+	};
+
+	for (int i = 0; i < 13; ++i) {
+		if (!overlapOnAxis(v, box, test[i])) {
+			return false; // Seperating axis found
+		}
+	}
+
+	return true; // Seperating axis not found
+}
+
+bool TriangleMesh::overlapOnAxis(const glm::vec3* v, const AABB& box, const glm::vec3& axis) {
+	glm::vec2 a = getInterval(box, axis);
+	glm::vec2 b = getInterval(v, axis);
+	return ((b.x <= a.y) && (a.x <= b.y));
+}
+
+//X = min, Y = max
+glm::vec2 TriangleMesh::getInterval(const glm::vec3* v, const glm::vec3& axis) {
+	glm::vec2 result;
+
+	result.x = glm::dot(axis, v[0]);
+	result.y = result.x;
+
+	float value = glm::dot(axis, v[1]);
+	result.x = std::min(result.x, value);
+	result.y = std::max(result.y, value);
+	value = glm::dot(axis, v[2]);
+	result.x = std::min(result.x, value);
+	result.y = std::max(result.y, value);
+
+	return result;
+}
+
+glm::vec2 TriangleMesh::getInterval(const AABB& aabb, const glm::vec3& axis) {
+	glm::vec3 i = aabb.getMin();
+	glm::vec3 a = aabb.getMax();
+
+	glm::vec3 vertex[8] = {
+		glm::vec3(i.x, a.y, a.z),
+		glm::vec3(i.x, a.y, i.z),
+		glm::vec3(i.x, i.y, a.z),
+		glm::vec3(i.x, i.y, i.z),
+		glm::vec3(a.x, a.y, a.z),
+		glm::vec3(a.x, a.y, i.z),
+		glm::vec3(a.x, i.y, a.z),
+		glm::vec3(a.x, i.y, i.z)
+	};
+
+	glm::vec2 result;
+	result.x = result.y = glm::dot(axis, vertex[0]);
+
+	for (int i = 1; i < 8; ++i) {
+		float projection = glm::dot(axis, vertex[i]);
+		result.x = (projection < result.x) ? projection : result.x;
+		result.y = (projection > result.y) ? projection : result.y;
+	}
+
+	return result;
+}
+
+// Watertight ray/triangle test from "Watertight Ray/Triangle Intersection"
+// (Woop, Benthin, Wald 2013). The vertices are moved into a space where the
+// ray starts at the origin and points down +z, then the 2D edge functions
+// give the barycentrics directly. Rays hitting a shared edge always hit one
+// of the two triangles.
+Intersection TriangleMesh::intersect(uint32_t triangle, const Ray& ray) const {
+	glm::vec3 a = positions[indices[3 * triangle]] - ray.origin;
+	glm::vec3 b = positions[indices[3 * triangle + 1]] - ray.origin;
+	glm::vec3 c = positions[indices[3 * triangle + 2]] - ray.origin;
+
+	float ax = a[ray.kx] - ray.shear.x * a[ray.kz];
+	float ay = a[ray.ky] - ray.shear.y * a[ray.kz];
+	float bx = b[ray.kx] - ray.shear.x * b[ray.kz];
+	float by = b[ray.ky] - ray.shear.y * b[ray.kz];
+	float cx = c[ray.kx] - ray.shear.x * c[ray.kz];
+	float cy = c[ray.ky] - ray.shear.y * c[ray.kz];
+
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+
+	// Exactly on an edge, redo the edge functions in double so the
+	// neighbouring triangle agrees on the result
+	if (u == 0.0f || v == 0.0f || w == 0.0f) {
+		u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+		v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+		w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+	}
+
+	// Hit from either side, but all edge functions must agree in sign
+	if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+		return Intersection();
+	}
+	float det = u + v + w;
+	if (det == 0.0f) {
+		return Intersection();
+	}
+
+	float az = ray.shear.z * a[ray.kz];
+	float bz = ray.shear.z * b[ray.kz];
+	float cz = ray.shear.z * c[ray.kz];
+	float t = (u * az + v * bz + w * cz) / det;
+	if (t < 0.0001f) {
+		return Intersection();
+	}
+	return Intersection(t, glm::vec2(v / det, w / det));
+}
+
+glm::vec3 TriangleMesh::getNormal(uint32_t triangle, const glm::vec2& barycentrics) const {
+	if (!hasNormals()) {
+		return planeNormals[triangle];
+	}
+	glm::vec3 normal = normals[indices[3 * triangle]] * (1.0f - barycentrics.x - barycentrics.y)
+		+ normals[indices[3 * triangle + 1]] * barycentrics.x
+		+ normals[indices[3 * triangle + 2]] * barycentrics.y;
+	return glm::normalize(normal);
+}
+
+MeshTriangle::MeshTriangle(const TriangleMesh& mesh, uint32_t index) : mesh(mesh), index(index) {
+}
+
+MeshTriangle::~MeshTriangle() {
+}
+
+float MeshTriangle::getMinX() const {
+	return mesh.getMin(index).x;
+}
+
+float MeshTriangle::getMinY() const {
+	return mesh.getMin(index).y;
+}
+
+float MeshTriangle::getMinZ() const {
+	return mesh.getMin(index).z;
+}
+
+float MeshTriangle::getMaxX() const {
+	return mesh.getMax(index).x;
+}
+
+float MeshTriangle::getMaxY() const {
+	return mesh.getMax(index).y;
+}
+
+float MeshTriangle::getMaxZ() const {
+	return mesh.getMax(index).z;
+}
+
+bool MeshTriangle::isInside(const AABB& box) const {
+	return mesh.isInside(index, box);
+}
+
+Intersection MeshTriangle::intersect(const Ray& ray) const {
+	return mesh.intersect(index, ray);
+}
+
+glm::vec3 MeshTriangle::getNormal(const glm::vec3& /*point*/, const Intersection& hit) const {
+	return mesh.getNormal(index, hit.barycentrics);
+}
+
+uint32_t MeshTriangle::getMaterialIndex() const {
+	return mesh.getMaterialIndex();
+}
+
+glm::vec3 MeshTriangle::getVertex(int corner) const {
+	return mesh.getVertex(index, corner);
+}
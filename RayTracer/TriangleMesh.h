@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Shape.h"
+
+//Triangles sharing one material and transform. Vertices are stored once, in
+//world space, and triangles refer to them through an index buffer.
+class TriangleMesh
+{
+	public:
+		TriangleMesh(uint32_t materialIndex);
+		~TriangleMesh();
+		//Both return the index of the new vertex
+		uint32_t addVertex(const glm::vec3& position);
+		uint32_t addVertex(const glm::vec3& position, const glm::vec3& normal);
+		void addTriangle(uint32_t v1, uint32_t v2, uint32_t v3);
+		uint32_t getNumTriangles() const;
+		bool hasNormals() const;
+		uint32_t getMaterialIndex() const;
+		glm::vec3 getVertex(uint32_t triangle, int corner) const;
+		glm::vec3 getMin(uint32_t triangle) const;
+		glm::vec3 getMax(uint32_t triangle) const;
+		bool isInside(uint32_t triangle, const AABB& box) const;
+		Intersection intersect(uint32_t triangle, const Ray& ray) const;
+		//Vertex normals interpolated across the triangle, or the plane
+		//normal when the mesh has none
+		glm::vec3 getNormal(uint32_t triangle, const glm::vec2& barycentrics) const;
+
+	private:
+		std::vector<glm::vec3> positions;
+		//One per position, empty for meshes made with tri
+		std::vector<glm::vec3> normals;
+		//Three vertex indices per triangle
+		std::vector<uint32_t> indices;
+		//Unit normal of each triangle's plane, computed when it's added
+		std::vector<glm::vec3> planeNormals;
+		uint32_t materialIndex;
+		static bool overlapOnAxis(const glm::vec3* v, const AABB& box, const glm::vec3& axis);
+		static glm::vec2 getInterval(const AABB& aabb, const glm::vec3& axis);
+		static glm::vec2 getInterval(const glm::vec3* v, const glm::vec3& axis);
+};
+
+//One triangle of a mesh, so the trees can build over it like any other Shape
+class MeshTriangle final :
+	public Shape
+{
+	public:
+		MeshTriangle(const TriangleMesh& mesh, uint32_t index);
+		virtual ~MeshTriangle();
+		virtual float getMinX() const override;
+		virtual float getMinY() const override;
+		virtual float getMinZ() const override;
+		virtual float getMaxX() const override;
+		virtual float getMaxY() const override;
+		virtual float getMaxZ() const override;
+		virtual bool isInside(const AABB& box) const override;
+		virtual Intersection intersect(const Ray& ray) const override;
+		virtual glm::vec3 getNormal(const glm::vec3& point, const Intersection& hit) const override;
+		virtual uint32_t getMaterialIndex() const override;
+		glm::vec3 getVertex(int corner) const;
+
+	private:
+		const TriangleMesh& mesh;
+		uint32_t index;
+};
@@ -0,0 +1,363 @@
+#include "WideBVH.h"
+#include <algorithm>
+#include <limits>
+
+template<int Width>
+WideBVH<Width>::WideBVH(const Primitives& primitives) : BVH(primitives), boxKernel(SimdKernels::get().getBoxKernel<Width>()) {
+	if (nodes.empty()) {
+		return;
+	}
+	wideNodes.push_back(WideNode());
+	if (nodes[0].isLeaf()) {
+		//Whole scene fits in one leaf, hang it off an otherwise empty node
+		WideNode& root = wideNodes[0];
+		for (int i = 1; i < Width; ++i) {
+			setEmptyChild(root, i);
+		}
+		for (int axis = 0; axis < 3; ++axis) {
+			root.bounds[axis][0] = nodes[0].min[axis];
+			root.bounds[axis + 3][0] = nodes[0].max[axis];
+		}
+		root.child[0] = nodes[0].offset;
+		root.count[0] = nodes[0].count;
+	}
+	else {
+		collapse(0, 0);
+	}
+	//Only the wide nodes are traversed, leaves are shared with them
+	std::vector<LinearNode>().swap(nodes);
+}
+
+template<int Width>
+WideBVH<Width>::~WideBVH() {
+}
+
+// Pulls the grandchildren of the binary node up into one wide node by
+// repeatedly opening the interior child with the largest surface area,
+// since that is the child rays are most likely to enter.
+template<int Width>
+void WideBVH<Width>::collapse(uint32_t binaryIndex, uint32_t wideIndex) {
+	std::vector<uint32_t> children = { nodes[binaryIndex].offset, nodes[binaryIndex].offset + 1 };
+	while (children.size() < static_cast<size_t>(Width)) {
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (size_t i = 0; i < children.size(); ++i) {
+			const LinearNode& child = nodes[children[i]];
+			if (child.isLeaf()) {
+				continue;
+			}
+			float area = AABB(child.min, child.max).getSurfaceArea();
+			if (area > largestArea) {
+				largestArea = area;
+				largest = i;
+			}
+		}
+		if (largest == -1) {
+			break;
+		}
+		uint32_t opened = children[largest];
+		children[largest] = nodes[opened].offset;
+		children.push_back(nodes[opened].offset + 1);
+	}
+
+	//Interior children are allocated before recursing since wideNodes may grow
+	std::vector<std::pair<uint32_t, uint32_t>> interiorChildren;
+	for (int i = 0; i < Width; ++i) {
+		WideNode& node = wideNodes[wideIndex];
+		if (static_cast<size_t>(i) >= children.size()) {
+			setEmptyChild(node, i);
+			continue;
+		}
+		const LinearNode& child = nodes[children[i]];
+		for (int axis = 0; axis < 3; ++axis) {
+			node.bounds[axis][i] = child.min[axis];
+			node.bounds[axis + 3][i] = child.max[axis];
+		}
+		if (child.isLeaf()) {
+			node.child[i] = child.offset;
+			node.count[i] = child.count;
+		}
+		else {
+			uint32_t childIndex = wideNodes.size();
+			node.child[i] = childIndex;
+			node.count[i] = 0;
+			wideNodes.push_back(WideNode());
+			interiorChildren.push_back(std::make_pair(children[i], childIndex));
+		}
+	}
+	for (const std::pair<uint32_t, uint32_t>& child : interiorChildren) {
+		collapse(child.first, child.second);
+	}
+}
+
+template<int Width>
+void WideBVH<Width>::setEmptyChild(WideNode& node, int slot) {
+	for (int axis = 0; axis < 3; ++axis) {
+		node.bounds[axis][slot] = std::numeric_limits<float>::infinity();
+		node.bounds[axis + 3][slot] = -std::numeric_limits<float>::infinity();
+	}
+	node.child[slot] = 0;
+	node.count[slot] = 0;
+}
+
+template<int Width>
+Intersection WideBVH<Width>::findClosestIntersection(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	Intersection closest(maxDistance);
+	if (!wideNodes.empty()) {
+		traverseClosest(ray, StackEntry{ 0, 0, 0.0f }, closest, stats);
+	}
+	return closest.distAlongRay < maxDistance ? closest : Intersection();
+}
+
+template<int Width>
+bool WideBVH<Width>::isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const {
+	return !wideNodes.empty() && traverseOccluded(ray, StackEntry{ 0, 0, 0.0f }, maxDistance, stats);
+}
+
+// Children are pushed so the stack holds them nearest on top, and any entry
+// further away than the closest hit so far is dropped when popped.
+template<int Width>
+void WideBVH<Width>::traverseClosest(const Ray& ray, const StackEntry& start, Intersection& closest, TraversalStats& stats) const {
+	StackEntry stack[maxDepth * Width];
+	int stackSize = 0;
+	stack[stackSize++] = start;
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		if (entry.entryDistance > closest.distAlongRay) {
+			continue;
+		}
+		if (entry.count > 0) {
+			Intersection leafIntersect = intersectLeaf(entry.child, ray, closest.distAlongRay, stats);
+			if (leafIntersect.isValidIntersection() && leafIntersect.distAlongRay < closest.distAlongRay) {
+				closest = leafIntersect;
+			}
+			continue;
+		}
+		const WideNode& node = wideNodes[entry.child];
+		stats.nodesVisited++;
+		stats.boxTests += Width;
+		float entryDistances[Width];
+		int hitMask = intersectChildren(node, ray, closest.distAlongRay, entryDistances);
+		int firstPushed = stackSize;
+		for (int i = 0; i < Width; ++i) {
+			if (!(hitMask & (1 << i))) {
+				continue;
+			}
+			StackEntry child{ node.child[i], node.count[i], entryDistances[i] };
+			int j = stackSize++;
+			for (; j > firstPushed && stack[j - 1].entryDistance < child.entryDistance; --j) {
+				stack[j] = stack[j - 1];
+			}
+			stack[j] = child;
+		}
+	}
+}
+
+template<int Width>
+bool WideBVH<Width>::traverseOccluded(const Ray& ray, const StackEntry& start, float maxDistance, TraversalStats& stats) const {
+	StackEntry stack[maxDepth * Width];
+	int stackSize = 0;
+	stack[stackSize++] = start;
+	while (stackSize > 0) {
+		StackEntry entry = stack[--stackSize];
+		if (entry.count > 0) {
+			if (isLeafOccluded(entry.child, ray, maxDistance, stats)) {
+				return true;
+			}
+			continue;
+		}
+		const WideNode& node = wideNodes[entry.child];
+		stats.nodesVisited++;
+		stats.boxTests += Width;
+		float entryDistances[Width];
+		int hitMask = intersectChildren(node, ray, maxDistance, entryDistances);
+		for (int i = 0; i < Width; ++i) {
+			if (hitMask & (1 << i)) {
+				stack[stackSize++] = StackEntry{ node.child[i], node.count[i], entryDistances[i] };
+			}
+		}
+	}
+	return false;
+}
+
+// The rays of a packet go down the tree together while more than one of them
+// enters a node, so each node is fetched once for all of them. Children are
+// pushed nearest on top by the closest entry distance of any ray. A ray left
+// on its own finishes the subtree with the single ray traversal.
+template<int Width>
+void WideBVH<Width>::findClosestIntersections(const std::vector<Ray>& rays, Intersection* closest, TraversalStats& stats) const {
+	if (!isCoherent(rays)) {
+		BVH::findClosestIntersections(rays, closest, stats);
+		return;
+	}
+	for (size_t r = 0; r < rays.size(); ++r) {
+		closest[r] = Intersection();
+	}
+	if (wideNodes.empty() || rays.empty()) {
+		return;
+	}
+	PacketStackEntry stack[maxDepth * Width];
+	int stackSize = 0;
+	stack[stackSize++] = PacketStackEntry{ 0, 0, ~0ull >> (64 - rays.size()), 0.0f };
+	while (stackSize > 0) {
+		PacketStackEntry entry = stack[--stackSize];
+		// Rays that have hit something before the child can't hit anything in it
+		for (uint64_t remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+			int r = lowestRay(remaining);
+			if (closest[r].distAlongRay < entry.entryDistance) {
+				entry.rays &= ~(1ull << r);
+			}
+		}
+		if (entry.rays == 0) {
+			continue;
+		}
+		if ((entry.rays & (entry.rays - 1)) == 0) {
+			int r = lowestRay(entry.rays);
+			traverseClosest(rays[r], StackEntry{ entry.child, entry.count, 0.0f }, closest[r], stats);
+			continue;
+		}
+		if (entry.count > 0) {
+			for (uint64_t remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+				int r = lowestRay(remaining);
+				Intersection leafIntersect = intersectLeaf(entry.child, rays[r], closest[r].distAlongRay, stats);
+				if (leafIntersect.distAlongRay < closest[r].distAlongRay) {
+					closest[r] = leafIntersect;
+				}
+			}
+			continue;
+		}
+		const WideNode& node = wideNodes[entry.child];
+		stats.nodesVisited++;
+		uint64_t childRays[Width] = {};
+		float childEntry[Width];
+		std::fill(childEntry, childEntry + Width, std::numeric_limits<float>::infinity());
+		for (uint64_t remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+			int r = lowestRay(remaining);
+			stats.boxTests += Width;
+			float entryDistances[Width];
+			int hitMask = intersectChildren(node, rays[r], closest[r].distAlongRay, entryDistances);
+			for (int i = 0; i < Width; ++i) {
+				if (hitMask & (1 << i)) {
+					childRays[i] |= 1ull << r;
+					childEntry[i] = std::min(childEntry[i], entryDistances[i]);
+				}
+			}
+		}
+		//Children sorted furthest first, then pushed in that order
+		int order[Width];
+		int numEntered = 0;
+		for (int i = 0; i < Width; ++i) {
+			if (childRays[i] == 0) {
+				continue;
+			}
+			int j = numEntered++;
+			for (; j > 0 && childEntry[order[j - 1]] < childEntry[i]; --j) {
+				order[j] = order[j - 1];
+			}
+			order[j] = i;
+		}
+		for (int j = 0; j < numEntered; ++j) {
+			int i = order[j];
+			stack[stackSize++] = PacketStackEntry{ node.child[i], node.count[i], childRays[i], childEntry[i] };
+		}
+	}
+}
+
+// Rays drop out of the packet as soon as they are found to be blocked
+template<int Width>
+void WideBVH<Width>::findOccluded(const std::vector<Ray>& rays, const float* maxDistances, bool* occluded, TraversalStats& stats) const {
+	if (!isCoherent(rays)) {
+		BVH::findOccluded(rays, maxDistances, occluded, stats);
+		return;
+	}
+	for (size_t r = 0; r < rays.size(); ++r) {
+		occluded[r] = false;
+	}
+	if (wideNodes.empty() || rays.empty()) {
+		return;
+	}
+	uint64_t blocked = 0;
+	PacketStackEntry stack[maxDepth * Width];
+	int stackSize = 0;
+	stack[stackSize++] = PacketStackEntry{ 0, 0, ~0ull >> (64 - rays.size()), 0.0f };
+	while (stackSize > 0) {
+		PacketStackEntry entry = stack[--stackSize];
+		entry.rays &= ~blocked;
+		if (entry.rays == 0) {
+			continue;
+		}
+		if ((entry.rays & (entry.rays - 1)) == 0) {
+			int r = lowestRay(entry.rays);
+			if (traverseOccluded(rays[r], StackEntry{ entry.child, entry.count, 0.0f }, maxDistances[r], stats)) {
+				occluded[r] = true;
+				blocked |= entry.rays;
+			}
+			continue;
+		}
+		if (entry.count > 0) {
+			for (uint64_t remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+				int r = lowestRay(remaining);
+				if (isLeafOccluded(entry.child, rays[r], maxDistances[r], stats)) {
+					occluded[r] = true;
+					blocked |= 1ull << r;
+				}
+			}
+			continue;
+		}
+		const WideNode& node = wideNodes[entry.child];
+		stats.nodesVisited++;
+		uint64_t childRays[Width] = {};
+		for (uint64_t remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+			int r = lowestRay(remaining);
+			stats.boxTests += Width;
+			float entryDistances[Width];
+			int hitMask = intersectChildren(node, rays[r], maxDistances[r], entryDistances);
+			for (int i = 0; i < Width; ++i) {
+				if (hitMask & (1 << i)) {
+					childRays[i] |= 1ull << r;
+				}
+			}
+		}
+		for (int i = 0; i < Width; ++i) {
+			if (childRays[i] != 0) {
+				stack[stackSize++] = PacketStackEntry{ node.child[i], node.count[i], childRays[i], 0.0f };
+			}
+		}
+	}
+}
+
+template<int Width>
+bool WideBVH<Width>::isCoherent(const std::vector<Ray>& rays) {
+	for (const Ray& ray : rays) {
+		for (int axis = 0; axis < 3; ++axis) {
+			if (ray.sign[axis] != rays[0].sign[axis]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Same slab test as AABB::intersectInterval, one child at a time when the CPU
+// has no box kernel
+template<int Width>
+int WideBVH<Width>::intersectChildren(const WideNode& node, const Ray& ray, float maxDistance, float* entryDistances) const {
+	if (boxKernel != nullptr) {
+		return boxKernel(node.bounds, ray, maxDistance, entryDistances);
+	}
+	int hitMask = 0;
+	for (int i = 0; i < Width; ++i) {
+		float tmin = 0.0f;
+		float tmax = maxDistance;
+		for (int axis = 0; axis < 3; ++axis) {
+			tmin = std::max(tmin, (node.bounds[nearRow(ray, axis)][i] - ray.origin[axis]) * ray.invDir[axis]);
+			tmax = std::min(tmax, (node.bounds[farRow(ray, axis)][i] - ray.origin[axis]) * ray.invDir[axis]);
+		}
+		entryDistances[i] = tmin;
+		hitMask |= (tmin <= tmax) << i;
+	}
+	return hitMask;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
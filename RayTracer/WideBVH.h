@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "SceneObjects.hpp"
+#include "Shape.h"
+#include "BVH.h"
+#include "Simd.h"
+
+//BVH with Width (4 or 8) children per node, made by collapsing the binary
+//SAH tree. Child boxes are stored as separate coordinate arrays so one ray
+//is tested against all of them together with the SimdKernels.
+template<int Width>
+class WideBVH : public BVH{
+	public:
+		WideBVH(const Primitives& primitives);
+		virtual ~WideBVH();
+		virtual Intersection findClosestIntersection(const Ray& ray, float maxDistance, TraversalStats& stats) const override;
+		virtual bool isOccluded(const Ray& ray, float maxDistance, TraversalStats& stats) const override;
+		virtual void findClosestIntersections(const std::vector<Ray>& rays, Intersection* closest, TraversalStats& stats) const override;
+		virtual void findOccluded(const std::vector<Ray>& rays, const float* maxDistances, bool* occluded, TraversalStats& stats) const override;
+
+	private:
+		struct WideNode {
+			//Rows are minX, minY, minZ, maxX, maxY, maxZ of every child
+			float bounds[6][Width];
+			//Interior child: index into wideNodes
+			//Leaf child: index into leaves
+			uint32_t child[Width];
+			//Number of objects in a leaf child, 0 for interior children.
+			//Unused slots have an empty box so rays never enter them.
+			uint32_t count[Width];
+		};
+		struct StackEntry {
+			uint32_t child;
+			uint32_t count;
+			float entryDistance;
+		};
+		//Bit i of rays is set for packet ray i, entryDistance is the nearest
+		//any of them enters the child
+		struct PacketStackEntry {
+			uint32_t child;
+			uint32_t count;
+			uint64_t rays;
+			float entryDistance;
+		};
+		std::vector<WideNode> wideNodes;
+		//Chosen for the CPU when the tree is made, nullptr to test boxes one at a time
+		SimdKernels::BoxKernel<Width> boxKernel;
+		void collapse(uint32_t binaryIndex, uint32_t wideIndex);
+		static void setEmptyChild(WideNode& node, int slot);
+		//Rows of WideNode::bounds holding the plane the ray meets first and last on axis
+		static int nearRow(const Ray& ray, int axis) {
+			return axis + 3 * ray.sign[axis];
+		}
+		static int farRow(const Ray& ray, int axis) {
+			return axis + 3 * (1 - ray.sign[axis]);
+		}
+		//Bit i of the result is set when child i is entered before maxDistance
+		int intersectChildren(const WideNode& node, const Ray& ray, float maxDistance, float* entryDistances) const;
+		//Single ray traversal of the subtree at start. closest may already
+		//hold a hit, only closer ones replace it.
+		void traverseClosest(const Ray& ray, const StackEntry& start, Intersection& closest, TraversalStats& stats) const;
+		bool traverseOccluded(const Ray& ray, const StackEntry& start, float maxDistance, TraversalStats& stats) const;
+		//Packets are only traced together when every ray's direction has the
+		//same signs, so the rays enter each box through the same planes
+		static bool isCoherent(const std::vector<Ray>& rays);
+		//Index of the lowest set bit, rays must not be 0
+		static int lowestRay(uint64_t rays) {
+#if defined(__GNUC__) || defined(__clang__)
+			return __builtin_ctzll(rays);
+#else
+			int index = 0;
+			for (; !(rays & 1); rays >>= 1) {
+				index++;
+			}
+			return index;
+#endif
+		}
+};
@@ -1,14 +1,17 @@
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <algorithm>
 #include <vector>
 #include <stdlib.h>
-#include <time.h>
+#include <cstdio>
 #include <unordered_map>
-
-//Both headers for getting file paths
-#include <windows.h>
-#include "Shlwapi.h"
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <utility>
 
 #include "FreeImage.h"
 #include <glm/glm.hpp>
@@ -18,8 +21,9 @@
 #include "SceneObjects.hpp"
 #include "Scene.h"
 #include "Shape.h"
-
-#pragma comment(lib, "Shlwapi.lib")
+#include "RenderStats.h"
+#include "Simd.h"
+#include "TaskScheduler.h"
 
 enum class Debug {
 	//Debug flags aren't assigned numbers to make them easier to iterate through
@@ -46,6 +50,27 @@ enum class Mode {
 	NONE
 };
 
+//Wall clock seconds spent in each phase of a render
+struct PhaseTimes {
+	double parse = 0.0;
+	double build = 0.0;
+	double render = 0.0;
+	double encode = 0.0;
+};
+
+//Scratch space for tracing packets. Each render thread has its own and reuses
+//it for every packet, so tracing a packet doesn't allocate.
+struct PacketBuffers {
+	std::vector<Ray> rays;
+	std::vector<Ray> shadowRays;
+	//Entry r * lightCount + l is set when light l is blocked from ray r's hit
+	std::unique_ptr<bool[]> lightOccluded;
+	PacketBuffers(size_t lightCount) : lightOccluded(new bool[AccelerationStructure::maxPacketSize * lightCount]) {
+		rays.reserve(AccelerationStructure::maxPacketSize);
+		shadowRays.reserve(AccelerationStructure::maxPacketSize);
+	}
+};
+
 std::ostream& operator<<(std::ostream &strm, const glm::vec3 &v1) {
 	return strm << "Vector(x: " << v1.x << " y: " << v1.y << " z: " << v1.z << ")";
 }
@@ -63,16 +88,31 @@ inline bool modeIs(Mode mode);
 inline void removeFeature(Feature feature);
 inline void addFeature(Feature feature);
 inline bool featureIsActive(Feature requestedFeature);
-inline bool debugIsActive(Debug requestedDebug);
+template<int Features>
+constexpr bool hasFeature(Feature requestedFeature);
+constexpr int getShadingFeatures(int features, Debug debug);
 std::string getEnabledFeaturesAsString();
 std::string getEnabledDebugAsString();
 float calculateDiffuseLighting(const glm::vec3& normal, const glm::vec3& objToLightDir);
 float calculateSpecularLighting(const Material& objMat, const glm::vec3& normal, const glm::vec3& halfAngle);
 float calculateAttenuation(const glm::vec3& attenuation, float distance);
-Color calculateLightingColor(const Scene& scene, const glm::vec3& intersectPoint, const glm::vec3& intersectNormal, const Material& objMat, const glm::vec3& viewPoint);
-Color computePixelColor(const Ray& ray, const Scene& scene, int currentDepth);
-void createPerformanceReport(const SceneMetaData& metaData, const std::string& outputFileName, const Scene& scene, const time_t& totalTimeInSeconds, int pixelsProcessed);
+glm::vec3 calculateLightDirection(const Light& light, const glm::vec3& intersectPoint, float& distance);
+template<int Features, Debug DebugMode>
+Color calculateLightingColor(const Scene& scene, const glm::vec3& intersectPoint, const glm::vec3& intersectNormal, const Material& objMat, const glm::vec3& viewPoint, RenderStats& stats, const bool* lightOccluded = nullptr);
+template<int Features, Debug DebugMode>
+Color computePixelColor(const Ray& ray, const Scene& scene, int currentDepth, RenderStats& stats);
+template<int Features, Debug DebugMode>
+Color shadeIntersection(const Ray& ray, const Intersection& closestIntersect, const Scene& scene, int currentDepth, RenderStats& stats, const bool* lightOccluded = nullptr);
+template<int Features, Debug DebugMode>
+void tracePacket(const Scene& scene, const std::vector<Ray>& rays, Color* colors, PacketBuffers& buffers, RenderStats& stats);
+double secondsSince(const std::chrono::steady_clock::time_point& start);
+void createPerformanceReport(const SceneMetaData& metaData, const std::string& outputFileName, const Scene& scene, const PhaseTimes& times, int pixelsProcessed, const RenderStats& stats);
+void reportRayType(std::ofstream& report, const std::string& rayType, unsigned long long rays, const TraversalStats& traversal, double renderTimeInSeconds);
 void createRender(const SceneMetaData& sceneFileData, std::string outputFileName="");
+typedef unsigned int (*RenderKernel)(const Scene& scene, std::vector<BYTE>& pixels, unsigned int tile, PacketBuffers& buffers, RenderStats& stats);
+template<int Features, Debug DebugMode>
+unsigned int renderTile(const Scene& scene, std::vector<BYTE>& pixels, unsigned int tile, PacketBuffers& buffers, RenderStats& stats);
+RenderKernel selectRenderKernel(int features, Debug debug);
 void createAllDebugRendersForScene(const SceneMetaData& metaData);
 void createAllFeatureRendersForScene(const SceneMetaData& metaData);
 void createAllRendersForScene(const SceneMetaData& metaData);
@@ -81,33 +121,53 @@ void createAllDebugRendersForScene(const std::string& sceneFile);
 void createAllRendersForScene(const std::string& sceneFile);
 
 int sampleTimeInSeconds = 5;
+//Worker threads for building and rendering, 0 for one per hardware thread
+unsigned int renderThreadCount = 0;
+unsigned int tileSize = 16;
+//Primary rays are traced in packetSize x packetSize bundles, 1 traces them one at a time
+constexpr unsigned int packetSize = 8;
+//Packets are held in fixed size arrays and ray masks are 64 bits wide
+static_assert(packetSize * packetSize <= AccelerationStructure::maxPacketSize, "packetSize x packetSize rays must fit in a packet");
 std::string testScenesDirectory = "test_scenes/";
 std::string reportDirectory = "reports/";
 std::string renderDirectory = "renders/";
 std::string debugRenderDirectory = "debug_renders/";
 std::string testFile = "scene1.test";
 std::unordered_map<Debug, std::string> debugNames({ { Debug::DIFFUSE_LIGHT_INTENSITY, "diffuse_intensity" },{ Debug::SPECULAR_LIGHT_INTENSITY, "specular_intensity" },{ Debug::NORMAL_MAP, "normals" },{ Debug::PRIMARY_INTERSECTION_MAP, "primary_intersect" },{ Debug::SHADOW_MAP, "shadow_intersect" },{ Debug::LIGHT_DIRECTION_MAP, "light_direction_map" },{ Debug::NONE, "none" } });
+std::unordered_map<TreeType, std::string> treeNames({ { TreeType::PARTITION, "partition" },{ TreeType::BVH, "bvh" },{ TreeType::BVH4, "bvh4" },{ TreeType::BVH8, "bvh8" },{ TreeType::LBVH, "lbvh" } });
 std::unordered_map<Feature, std::string> featureNames({ { Feature::DIFFUSE_LIGHTING, "diffuse" },{ Feature::SPECULAR_LIGHTING, "specular" },{ Feature::REFLECTIONS, "reflections" },{ Feature::SHADOWS, "shadows" },{ Feature::KEEP_TIME, "time" },{ Feature::REPORT_PERFORMANCE, "reporting" } });
 int featureFlags = (int)Feature::DIFFUSE_LIGHTING | (int)Feature::SHADOWS | (int)Feature::SPECULAR_LIGHTING | (int)Feature::KEEP_TIME | (int)Feature::REPORT_PERFORMANCE | (int)Feature::REFLECTIONS;
 Debug debugFlag = Debug::NONE;
+//Features that change the image, each combination of them gets its own render kernel
+const int shadingFeatures = (int)Feature::DIFFUSE_LIGHTING | (int)Feature::SPECULAR_LIGHTING | (int)Feature::SHADOWS | (int)Feature::REFLECTIONS;
 Mode currentMode = Mode::BENCHMARK;
+TreeType treeType = TreeType::BVH8;
+//Store geometry repeated under different transforms once and trace it as instances
+bool instanceMeshes = true;
 
 int main(int argc, char* argv[]) {
-	SceneMetaData metaData = createSceneMetaData("test_scenes/scene3_light.test");
+	TaskScheduler::configure(renderThreadCount);
+	//Scene file can be passed on the command line, e.g. RayTracer final_scenes/scene7.test
+	SceneMetaData metaData = createSceneMetaData(argc > 1 ? argv[1] : "test_scenes/scene3_light.test");
 	createRender(metaData);
 	//createAllRendersForScene(metaData);
 	std::cout << "Finished Rendering" << std::endl;
+#ifdef _WIN32
+	//Keep the console window open
 	std::cin.get();
+#endif
 	return 0;
 }
 
 void createRender(const SceneMetaData& sceneFileData, std::string outputFileName) {
 	std::string testFilePath = sceneFileData.filePath;
-	srand(NULL);
-	Scene scene(testFilePath);
+	srand(0);
+	Scene scene(testFilePath, treeType, instanceMeshes);
 	if (!scene.loaded()) {
 		std::cout << "Couldn't load scene. Is the file path correct? " << testFilePath << std::endl;
+#ifdef _WIN32
 		std::cin.get();
+#endif
 		exit(1);
 	}
 	if (outputFileName.empty()) {
@@ -122,133 +182,283 @@ void createRender(const SceneMetaData& sceneFileData, std::string outputFileName
 
 	std::vector<BYTE> pixels(w*h * 3);
 	scene.backgroundColor = Color(0, 0, 0);
-	Color pixelColor;
-	float widthOffset = 0.0f;
-	float heightOffset = 0.0f;
-	std::vector<Shape *> objects = scene.getSceneObjects();
-	Camera cam = scene.getCamera();
 	unsigned int total = w * h;
-	time_t startTime = time(NULL);
-	time_t lastSampleTime = startTime;
+	PhaseTimes times;
+	times.parse = scene.getParseTimeInSeconds();
+	times.build = scene.getBuildTimeInSeconds();
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point lastSampleTime = startTime;
 	double benchmarkTimeLimit = 60.0f*60.0f*30.0f; //30 minutes
-	struct tm sample = { 0 };
-	sample.tm_sec = sampleTimeInSeconds;
-	int currentPixel;
-	for (unsigned int i = 0; i < h; i++) {
-		for (unsigned int j = 0; j < w; j++) {
-			currentPixel = i * w + j;
-			if (featureIsActive(Feature::KEEP_TIME)) {
-				double seconds = difftime(time(NULL), lastSampleTime);
-				if (seconds > sampleTimeInSeconds) {
-					lastSampleTime = time(NULL);
-					float percentComplete = (currentPixel / static_cast<float>(total)) * 100.0f;
-					double totalTime = difftime(lastSampleTime, startTime);
-					double estTime = (static_cast<double>(total) - currentPixel) / (currentPixel / totalTime);
-					std::cout << percentComplete << "% complete. Estimated time: " << estTime << " seconds" << std::endl;
-				}
+
+	//The scheduler's workers render tiles until none are left or the benchmark
+	//time runs out, this thread only reports progress. Tiles are handed out by
+	//parallelFor, so threads that get cheap tiles steal the rest of the work.
+	TaskScheduler& scheduler = TaskScheduler::get();
+	std::atomic<unsigned int> pixelsProcessed(0);
+	std::atomic<bool> stopRendering(false);
+	std::vector<RenderStats> threadStats(scheduler.getNumWorkers() + 1);
+	std::vector<PacketBuffers> threadBuffers;
+	threadBuffers.reserve(threadStats.size());
+	for (size_t i = 0; i < threadStats.size(); ++i) {
+		threadBuffers.emplace_back(scene.getLights().size());
+	}
+	RenderKernel renderKernel = selectRenderKernel(featureFlags, debugFlag);
+	unsigned int numTiles = ((w + tileSize - 1) / tileSize) * ((h + tileSize - 1) / tileSize);
+	TaskScheduler::TaskGroup rendering(scheduler);
+	rendering.run([&]() {
+		scheduler.parallelFor(0, numTiles, 1, [&](size_t firstTile, size_t lastTile) {
+			for (size_t tile = firstTile; tile < lastTile && !stopRendering; ++tile) {
+				unsigned int thread = scheduler.getThreadIndex();
+				pixelsProcessed += renderKernel(scene, pixels, tile, threadBuffers[thread], threadStats[thread]);
+			}
+		});
+	});
+	while (!rendering.isDone()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		unsigned int currentPixel = pixelsProcessed;
+		if (featureIsActive(Feature::KEEP_TIME)) {
+			if (secondsSince(lastSampleTime) > sampleTimeInSeconds) {
+				lastSampleTime = std::chrono::steady_clock::now();
+				float percentComplete = (currentPixel / static_cast<float>(total)) * 100.0f;
+				double totalTime = secondsSince(startTime);
+				double estTime = (static_cast<double>(total) - currentPixel) / (currentPixel / totalTime);
+				std::cout << percentComplete << "% complete. Estimated time: " << estTime << " seconds" << std::endl;
 			}
-			widthOffset = 0.5f;
-			heightOffset = 0.5f;
-			Ray ray = cam.createRayToPixel(j + widthOffset, i + heightOffset, w, h);
-			pixelColor = computePixelColor(ray, scene, 0);
-			pixels[i*w * 3 + j * 3] = pixelColor.getB();
-			pixels[i*w * 3 + (j * 3) + 1] = pixelColor.getG();
-			pixels[i*w * 3 + (j * 3) + 2] = pixelColor.getR();
 		}
 		if (modeIs(Mode::BENCHMARK)) {
-			if (difftime(time(NULL), startTime) > benchmarkTimeLimit) {
-				break;
+			if (secondsSince(startTime) > benchmarkTimeLimit) {
+				stopRendering = true;
 			}
 		}
 	}
-	++currentPixel;
-	if (currentPixel == w * h) {
+	rendering.wait();
+	times.render = secondsSince(startTime);
+	RenderStats stats;
+	for (const RenderStats& workerStats : threadStats) {
+		stats += workerStats;
+	}
+	unsigned int currentPixel = pixelsProcessed;
+	if (currentPixel == total) {
+		std::chrono::steady_clock::time_point encodeStart = std::chrono::steady_clock::now();
 		Renderer render(w, h);
 		BYTE * outPixels = &pixels[0];
 		render.createImage(outPixels, outputFileName);
+		times.encode = secondsSince(encodeStart);
 	}
 	if (featureIsActive(Feature::REPORT_PERFORMANCE)) {
-		time_t totalTime = time(NULL) - startTime;
-		createPerformanceReport(sceneFileData, outputFileName, scene, totalTime, currentPixel);
+		createPerformanceReport(sceneFileData, outputFileName, scene, times, currentPixel, stats);
 	}
 }
 
-Color computePixelColor(const Ray& ray, const Scene& scene, int currentDepth) {
-	if (currentDepth <= scene.maxDepth) {
-		Intersection closestIntersect = scene.findClosestIntersection(ray);
-		if (!closestIntersect.isValidIntersection()) {
-			return scene.backgroundColor;
+//Features selects the shading features (see getShadingFeatures) and DebugMode
+//the debug map. Both are fixed for the whole render, so every check of them
+//below is decided when the kernel is compiled. Returns the number of pixels
+//in the tile.
+template<int Features, Debug DebugMode>
+unsigned int renderTile(const Scene& scene, std::vector<BYTE>& pixels, unsigned int tile, PacketBuffers& buffers, RenderStats& stats) {
+	const Camera& cam = scene.getCamera();
+	unsigned int w = scene.getWidth();
+	unsigned int h = scene.getHeight();
+	unsigned int tilesWide = (w + tileSize - 1) / tileSize;
+	float widthOffset = 0.5f;
+	float heightOffset = 0.5f;
+	//Counted locally and added at the end so threads don't share cache lines
+	RenderStats localStats;
+	std::vector<Ray>& packet = buffers.rays;
+	Color packetColors[AccelerationStructure::maxPacketSize];
+	unsigned int startRow = (tile / tilesWide) * tileSize;
+	unsigned int startColumn = (tile % tilesWide) * tileSize;
+	unsigned int endRow = std::min(startRow + tileSize, h);
+	unsigned int endColumn = std::min(startColumn + tileSize, w);
+	if (packetSize > 1) {
+		for (unsigned int packetRow = startRow; packetRow < endRow; packetRow += packetSize) {
+			for (unsigned int packetColumn = startColumn; packetColumn < endColumn; packetColumn += packetSize) {
+				unsigned int packetEndRow = std::min(packetRow + packetSize, endRow);
+				unsigned int packetEndColumn = std::min(packetColumn + packetSize, endColumn);
+				packet.clear();
+				for (unsigned int i = packetRow; i < packetEndRow; i++) {
+					for (unsigned int j = packetColumn; j < packetEndColumn; j++) {
+						packet.push_back(cam.createRayToPixel(j + widthOffset, i + heightOffset, w, h));
+					}
+				}
+				tracePacket<Features, DebugMode>(scene, packet, packetColors, buffers, localStats);
+				int k = 0;
+				for (unsigned int i = packetRow; i < packetEndRow; i++) {
+					for (unsigned int j = packetColumn; j < packetEndColumn; j++, k++) {
+						pixels[i*w * 3 + j * 3] = packetColors[k].getB();
+						pixels[i*w * 3 + (j * 3) + 1] = packetColors[k].getG();
+						pixels[i*w * 3 + (j * 3) + 2] = packetColors[k].getR();
+					}
+				}
+			}
 		}
-		else {
-			if (debugIsActive(Debug::PRIMARY_INTERSECTION_MAP)) {
-				return Color(1.0f, 0.0f, 0.0f);
+	}
+	else {
+		for (unsigned int i = startRow; i < endRow; i++) {
+			for (unsigned int j = startColumn; j < endColumn; j++) {
+				Ray ray = cam.createRayToPixel(j + widthOffset, i + heightOffset, w, h);
+				Color pixelColor = computePixelColor<Features, DebugMode>(ray, scene, 0, localStats);
+				pixels[i*w * 3 + j * 3] = pixelColor.getB();
+				pixels[i*w * 3 + (j * 3) + 1] = pixelColor.getG();
+				pixels[i*w * 3 + (j * 3) + 2] = pixelColor.getR();
 			}
-			else {
-				Color lightColor = calculateLightingColor(scene, Camera::createPointFromRay(ray, closestIntersect.distAlongRay), closestIntersect.intersectNormal, closestIntersect.mat, ray.origin);
-				Ray reflectRay(Camera::createPointFromRay(ray, closestIntersect.distAlongRay), glm::normalize(ray.dir - 2.0f*glm::dot(ray.dir, closestIntersect.intersectNormal)*closestIntersect.intersectNormal));
-				if (featureIsActive(Feature::REFLECTIONS)) {
-					return lightColor + closestIntersect.mat.specular*computePixelColor(reflectRay, scene, ++currentDepth);
-				}
-				else {
-					return lightColor;
+		}
+	}
+	stats += localStats;
+	return (endRow - startRow) * (endColumn - startColumn);
+}
+
+// Same result as computePixelColor on each ray. The primary rays are traced
+// together, then for each light the shadow rays from their hit points. Rays
+// after the first bounce go off in different directions so reflections are
+// traced one at a time.
+template<int Features, Debug DebugMode>
+void tracePacket(const Scene& scene, const std::vector<Ray>& rays, Color* colors, PacketBuffers& buffers, RenderStats& stats) {
+	if (scene.maxDepth < 0) {
+		std::fill(colors, colors + rays.size(), Color());
+		return;
+	}
+	Intersection hits[AccelerationStructure::maxPacketSize];
+	stats.primaryRays += rays.size();
+	scene.findClosestIntersections(rays, hits, stats.primary);
+
+	const std::vector<Light>& lights = scene.getLights();
+	bool* lightOccluded = buffers.lightOccluded.get();
+	bool traceShadows = hasFeature<Features>(Feature::SHADOWS) && !lights.empty();
+	if (traceShadows) {
+		std::fill(lightOccluded, lightOccluded + rays.size() * lights.size(), false);
+		std::vector<Ray>& shadowRays = buffers.shadowRays;
+		int shadowPixels[AccelerationStructure::maxPacketSize];
+		float maxDistances[AccelerationStructure::maxPacketSize];
+		bool blocked[AccelerationStructure::maxPacketSize];
+		for (size_t l = 0; l < lights.size(); ++l) {
+			shadowRays.clear();
+			for (size_t r = 0; r < rays.size(); ++r) {
+				if (!hits[r].isValidIntersection()) {
+					continue;
 				}
+				glm::vec3 intersectPoint = Camera::createPointFromRay(rays[r], hits[r].distAlongRay);
+				glm::vec3 lightDir = calculateLightDirection(lights[l], intersectPoint, maxDistances[shadowRays.size()]);
+				shadowPixels[shadowRays.size()] = r;
+				shadowRays.push_back(Ray(intersectPoint, glm::normalize(lightDir)));
 			}
+			stats.shadowRays += shadowRays.size();
+			scene.findOccluded(shadowRays, maxDistances, blocked, stats.shadow);
+			for (size_t s = 0; s < shadowRays.size(); ++s) {
+				lightOccluded[shadowPixels[s] * lights.size() + l] = blocked[s];
+			}
+		}
+	}
+	for (size_t r = 0; r < rays.size(); ++r) {
+		colors[r] = shadeIntersection<Features, DebugMode>(rays[r], hits[r], scene, 0, stats, traceShadows ? &lightOccluded[r * lights.size()] : nullptr);
+	}
+}
+
+template<int Features, Debug DebugMode>
+Color computePixelColor(const Ray& ray, const Scene& scene, int currentDepth, RenderStats& stats) {
+	if (currentDepth <= scene.maxDepth) {
+		Intersection closestIntersect;
+		if (currentDepth == 0) {
+			stats.primaryRays++;
+			closestIntersect = scene.findClosestIntersection(ray, stats.primary);
+		}
+		else {
+			stats.reflectionRays++;
+			closestIntersect = scene.findClosestIntersection(ray, stats.reflection);
 		}
+		return shadeIntersection<Features, DebugMode>(ray, closestIntersect, scene, currentDepth, stats);
 	}
 	else {
 		return Color();
 	}
 }
 
-Color calculateLightingColor(const Scene& scene, const glm::vec3& intersectPoint, const glm::vec3& intersectNormal, const Material& objMat, const glm::vec3& viewPoint) {
-	Color colorFromLights = objMat.ambient + objMat.emission;
-	Color diffuseLightColor;
-	Color specularLightColor;
-	int j = 0;
-	for (Light light : scene.getLights()) {
-		glm::vec3 lightRayDir;
-		glm::vec3 lightDir;
-		float distance;
-		float atten;
-		if (light.isPointLight()) {
-			lightDir = glm::vec3(light.location) - intersectPoint;
-			distance = glm::length(lightDir);
-			atten = calculateAttenuation(scene.attenuation, distance);
+//lightOccluded has an entry per light saying if it is blocked from the hit
+//point, without it shadow rays are traced here
+template<int Features, Debug DebugMode>
+Color shadeIntersection(const Ray& ray, const Intersection& closestIntersect, const Scene& scene, int currentDepth, RenderStats& stats, const bool* lightOccluded) {
+	if (!closestIntersect.isValidIntersection()) {
+		return scene.backgroundColor;
+	}
+	else {
+		if (DebugMode == Debug::PRIMARY_INTERSECTION_MAP) {
+			return Color(1.0f, 0.0f, 0.0f);
 		}
 		else {
-			lightDir = glm::vec3(light.location);
-			atten = 1.0f;
+			const Material& hitMaterial = scene.getMaterial(closestIntersect.materialIndex);
+			Color lightColor = calculateLightingColor<Features, DebugMode>(scene, Camera::createPointFromRay(ray, closestIntersect.distAlongRay), closestIntersect.intersectNormal, hitMaterial, ray.origin, stats, lightOccluded);
+			Ray reflectRay(Camera::createPointFromRay(ray, closestIntersect.distAlongRay), glm::normalize(ray.dir - 2.0f*glm::dot(ray.dir, closestIntersect.intersectNormal)*closestIntersect.intersectNormal));
+			if (hasFeature<Features>(Feature::REFLECTIONS)) {
+				return lightColor + hitMaterial.specular*computePixelColor<Features, DebugMode>(reflectRay, scene, ++currentDepth, stats);
+			}
+			else {
+				return lightColor;
+			}
 		}
+	}
+}
+
+//Unnormalized direction from intersectPoint to the light. distance is how far
+//away the light is, infinite for directional lights since anything along the
+//ray blocks them.
+glm::vec3 calculateLightDirection(const Light& light, const glm::vec3& intersectPoint, float& distance) {
+	if (light.isPointLight()) {
+		glm::vec3 lightDir = glm::vec3(light.location) - intersectPoint;
+		distance = glm::length(lightDir);
+		return lightDir;
+	}
+	distance = std::numeric_limits<float>::infinity();
+	return glm::vec3(light.location);
+}
+
+template<int Features, Debug DebugMode>
+Color calculateLightingColor(const Scene& scene, const glm::vec3& intersectPoint, const glm::vec3& intersectNormal, const Material& objMat, const glm::vec3& viewPoint, RenderStats& stats, const bool* lightOccluded) {
+	Color colorFromLights = objMat.ambient + objMat.emission;
+	const std::vector<Light>& lights = scene.getLights();
+	for (size_t l = 0; l < lights.size(); ++l) {
+		const Light& light = lights[l];
+		float distance;
+		glm::vec3 lightDir = calculateLightDirection(light, intersectPoint, distance);
+		float atten = light.isPointLight() ? calculateAttenuation(scene.attenuation, distance) : 1.0f;
 		Ray ray(intersectPoint, glm::normalize(lightDir));
-		Intersection intersect = scene.findClosestIntersection(ray);
-		if (!intersect.isValidIntersection() || intersect.distAlongRay >= glm::length(lightDir) || !featureIsActive(Feature::SHADOWS)) {
+		bool occluded = false;
+		if (hasFeature<Features>(Feature::SHADOWS)) {
+			if (lightOccluded != nullptr) {
+				occluded = lightOccluded[l];
+			}
+			else {
+				stats.shadowRays++;
+				occluded = scene.isOccluded(ray, distance, stats.shadow);
+			}
+		}
+		if (!occluded) {
 			float diffuseLightIntensity = calculateDiffuseLighting(intersectNormal, lightDir);
 			glm::vec3 eyeDir = viewPoint - intersectPoint;
 			glm::vec3 halfAngle = glm::normalize(glm::normalize(lightDir) + glm::normalize(eyeDir));
 			float specularLightIntensity = calculateSpecularLighting(objMat, intersectNormal, halfAngle);
-			if (debugIsActive(Debug::DIFFUSE_LIGHT_INTENSITY)) {
+			if (DebugMode == Debug::DIFFUSE_LIGHT_INTENSITY) {
 				colorFromLights += Color(diffuseLightIntensity, diffuseLightIntensity, diffuseLightIntensity);
 			}
-			else if (debugIsActive(Debug::SPECULAR_LIGHT_INTENSITY)) {
+			else if (DebugMode == Debug::SPECULAR_LIGHT_INTENSITY) {
 				colorFromLights += Color(specularLightIntensity, specularLightIntensity, specularLightIntensity);
 			}
-			else if (debugIsActive(Debug::NORMAL_MAP)) {
+			else if (DebugMode == Debug::NORMAL_MAP) {
 				colorFromLights += Color(intersectNormal.x, intersectNormal.y, intersectNormal.z);
 			}
-			else if (debugIsActive(Debug::LIGHT_DIRECTION_MAP)) {
+			else if (DebugMode == Debug::LIGHT_DIRECTION_MAP) {
 				colorFromLights += Color(halfAngle.x, halfAngle.y, halfAngle.z);
 			}
 			else {
-				if (featureIsActive(Feature::DIFFUSE_LIGHTING)) {
+				if (hasFeature<Features>(Feature::DIFFUSE_LIGHTING)) {
 					colorFromLights += atten * objMat.diffuse * diffuseLightIntensity * light.color;
 				}
-				if (featureIsActive(Feature::SPECULAR_LIGHTING)) {
+				if (hasFeature<Features>(Feature::SPECULAR_LIGHTING)) {
 					colorFromLights += atten * objMat.specular* specularLightIntensity * light.color;
 				}
 			}
 		}
-		else if (debugIsActive(Debug::SHADOW_MAP)) {
-			colorFromLights += intersect.mat.diffuse;
+		else if (DebugMode == Debug::SHADOW_MAP) {
+			colorFromLights += scene.getMaterial(scene.findClosestIntersection(ray, stats.shadow).materialIndex).diffuse;
 		}
 	}
 
@@ -267,8 +477,15 @@ float calculateAttenuation(const glm::vec3& attenuation, float distance) {
 	return 1.0f / (attenuation.x + attenuation.y*distance + attenuation.z*glm::pow(distance, 2.0f));
 }
 
+double secondsSince(const std::chrono::steady_clock::time_point& start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 SceneMetaData createSceneMetaData(const std::string& sceneFilePath) {
-	SceneMetaData metaData(sceneFilePath, PathFindFileName(sceneFilePath.c_str()));
+	//Scene title is the file name without any directories, either separator works on Windows
+	std::string::size_type lastSeparator = sceneFilePath.find_last_of("/\\");
+	std::string sceneTitle = lastSeparator == std::string::npos ? sceneFilePath : sceneFilePath.substr(lastSeparator + 1);
+	SceneMetaData metaData(sceneFilePath, sceneTitle);
 	return metaData;
 }
 
@@ -288,8 +505,54 @@ inline bool featureIsActive(Feature requestedFeature) {
 	return featureFlags & static_cast<int>(requestedFeature);
 }
 
-inline bool debugIsActive(Debug requestedDebug) {
-	return debugFlag == requestedDebug;
+template<int Features>
+constexpr bool hasFeature(Feature requestedFeature) {
+	return (Features & static_cast<int>(requestedFeature)) != 0;
+}
+
+//The features that change how pixels look with the debug map on. The
+//intensity, normal and light direction maps replace the diffuse and specular
+//terms, and the primary intersection map doesn't shade at all. Render kernels
+//are only made for these combinations.
+constexpr int getShadingFeatures(int features, Debug debug) {
+	if (debug == Debug::PRIMARY_INTERSECTION_MAP) {
+		return 0;
+	}
+	if (debug == Debug::NONE || debug == Debug::SHADOW_MAP) {
+		return features & shadingFeatures;
+	}
+	return features & ((int)Feature::SHADOWS | (int)Feature::REFLECTIONS);
+}
+
+template<int Features>
+RenderKernel selectRenderKernel(Debug debug) {
+	switch (debug) {
+	case Debug::DIFFUSE_LIGHT_INTENSITY:
+		return renderTile<getShadingFeatures(Features, Debug::DIFFUSE_LIGHT_INTENSITY), Debug::DIFFUSE_LIGHT_INTENSITY>;
+	case Debug::SPECULAR_LIGHT_INTENSITY:
+		return renderTile<getShadingFeatures(Features, Debug::SPECULAR_LIGHT_INTENSITY), Debug::SPECULAR_LIGHT_INTENSITY>;
+	case Debug::NORMAL_MAP:
+		return renderTile<getShadingFeatures(Features, Debug::NORMAL_MAP), Debug::NORMAL_MAP>;
+	case Debug::SHADOW_MAP:
+		return renderTile<getShadingFeatures(Features, Debug::SHADOW_MAP), Debug::SHADOW_MAP>;
+	case Debug::PRIMARY_INTERSECTION_MAP:
+		return renderTile<getShadingFeatures(Features, Debug::PRIMARY_INTERSECTION_MAP), Debug::PRIMARY_INTERSECTION_MAP>;
+	case Debug::LIGHT_DIRECTION_MAP:
+		return renderTile<getShadingFeatures(Features, Debug::LIGHT_DIRECTION_MAP), Debug::LIGHT_DIRECTION_MAP>;
+	default:
+		return renderTile<Features, Debug::NONE>;
+	}
+}
+
+template<int... FeatureSets>
+RenderKernel selectRenderKernel(int features, Debug debug, std::integer_sequence<int, FeatureSets...>) {
+	const RenderKernel kernels[] = { selectRenderKernel<FeatureSets>(debug)... };
+	return kernels[features & shadingFeatures];
+}
+
+//Picked once per render from the runtime flags
+RenderKernel selectRenderKernel(int features, Debug debug) {
+	return selectRenderKernel(features, debug, std::make_integer_sequence<int, shadingFeatures + 1>());
 }
 
 std::string getEnabledFeaturesAsString() {
@@ -311,7 +574,7 @@ std::string getEnabledDebugAsString() {
 	return debugNames.find(debugFlag)->second;
 }
 
-void createPerformanceReport(const SceneMetaData& metaData, const std::string& outputFileName, const Scene& scene, const time_t& totalTimeInSeconds, int pixelsProcessed) {
+void createPerformanceReport(const SceneMetaData& metaData, const std::string& outputFileName, const Scene& scene, const PhaseTimes& times, int pixelsProcessed, const RenderStats& stats) {
 	std::ofstream report;
 	SceneMetaData outputMeta=createSceneMetaData(outputFileName);
 	report.open(reportDirectory + outputMeta.sceneTitle + "_report.txt");
@@ -320,29 +583,65 @@ void createPerformanceReport(const SceneMetaData& metaData, const std::string& o
 	}
 	report << "PERFORMANCE REPORT FOR " << outputMeta.sceneTitle << std::endl;
 	report << "--------------------------------------------------------------------" << std::endl << std::endl;
-	report << std::min(static_cast<int>(((pixelsProcessed / static_cast<float>(scene.getWidth()) * scene.getHeight()) * 100)), 100) << "% Completed" << std::endl << std::endl;
+	report << std::min(static_cast<int>(pixelsProcessed / (static_cast<float>(scene.getWidth()) * scene.getHeight()) * 100), 100) << "% Completed" << std::endl << std::endl;
 	report << "Input Scene File: " << metaData.filePath << std::endl;
 	report << "Output Image: " << outputFileName << std::endl;
 	report << "Resolution: " << scene.getWidth() << "x" << scene.getHeight() << std::endl;
 	report << "Pixels Processed: " << pixelsProcessed << std::endl << std::endl;
 	report << "Features Enabled: " << getEnabledFeaturesAsString() << std::endl;
-	report << "Debug Options: " << getEnabledDebugAsString() << std::endl << std::endl;
+	report << "Debug Options: " << getEnabledDebugAsString() << std::endl;
+	report << "Acceleration Structure: " << treeNames.find(treeType)->second << std::endl;
+	report << "SIMD Kernels: " << SimdKernels::get().name << std::endl;
+	report << "Worker Threads: " << TaskScheduler::get().getNumWorkers() << std::endl;
+	if (packetSize > 1) {
+		report << "Primary Ray Packets: " << packetSize << "x" << packetSize << std::endl << std::endl;
+	}
+	else {
+		report << "Primary Ray Packets: none" << std::endl << std::endl;
+	}
+	double totalTimeInSeconds = times.parse + times.build + times.render + times.encode;
+	int wholeSeconds = static_cast<int>(totalTimeInSeconds);
 	char buffer[80];
-	struct tm timeInfo = { 0 };
-	localtime_s(&timeInfo, &totalTimeInSeconds);
-	strftime(buffer, 80, "%H hours %M minutes %S seconds", &timeInfo);
-	report << "Render Time: " << buffer << std::endl;
-	report << "Milliseconds Per Pixel: " << totalTimeInSeconds * 1000 / static_cast<float>(pixelsProcessed) << std::endl << std::endl;
-	report << "Time Breakdown" << std::endl;
+	snprintf(buffer, 80, "%02d hours %02d minutes %06.3f seconds", wholeSeconds / 3600, (wholeSeconds / 60) % 60, totalTimeInSeconds - (wholeSeconds / 60) * 60);
+	report << "Total Time: " << buffer << std::endl << std::endl;
+	report << std::fixed << std::setprecision(6);
+	report << "Time Breakdown (seconds)" << std::endl;
+	report << "----- Scene Parse: " << times.parse << std::endl;
+	report << "----- Acceleration Structure Build: " << times.build << std::endl;
+	report << "----- Rendering: " << times.render << std::endl;
+	report << "----- Image Encode: " << times.encode << std::endl;
+	//What a faster to build but slower to trace tree trades off
+	report << "Build And Render: " << times.build + times.render << std::endl << std::endl;
+	//Throughput only counts time spent rendering pixels
+	report << "Milliseconds Per Pixel: " << times.render * 1000 / pixelsProcessed << std::endl;
+	report << "Pixels Per Second: " << static_cast<long long>(pixelsProcessed / times.render) << std::endl;
+	report << "Rays Per Second: " << static_cast<long long>(stats.getTotalRays() / times.render) << std::endl << std::endl;
+	//Per type rates are rays of that type over the whole render time
+	report << "Ray Statistics" << std::endl;
+	reportRayType(report, "Primary", stats.primaryRays, stats.primary, times.render);
+	reportRayType(report, "Shadow", stats.shadowRays, stats.shadow, times.render);
+	reportRayType(report, "Reflection", stats.reflectionRays, stats.reflection, times.render);
+	reportRayType(report, "All", stats.getTotalRays(), stats.getTotalTraversal(), times.render);
 	report << "Total objects: " << scene.getNumObjects() << std::endl;
 	report << "----- Spheres: " << scene.getNumSpheres() << std::endl;
-	report << "----- Triangles: " << scene.getNumTriangles() << std::endl;
+	report << "----- Triangles: " << scene.getNumTriangles() << " in " << scene.getNumMeshes() << " meshes" << std::endl;
+	report << "----- Instances: " << scene.getNumInstances() << " of " << scene.getNumInstancedMeshes() << " shared meshes" << std::endl;
 	report << "Total lights: " << scene.getNumLights() << std::endl;
 	report << "----- Directional: " << scene.getNumDirectionalLights() << std::endl;
 	report << "----- Point: " << scene.getNumPointLights() << std::endl;
 	report.close();
 }
 
+void reportRayType(std::ofstream& report, const std::string& rayType, unsigned long long rays, const TraversalStats& traversal, double renderTimeInSeconds) {
+	//Averages are 0 rather than NaN for ray types that weren't traced
+	double perRay = rays > 0 ? 1.0 / rays : 0.0;
+	report << rayType << " Rays: " << rays << " (" << rays / renderTimeInSeconds / 1000000.0 << " Mrays/s)" << std::endl;
+	report << "----- Nodes Visited: " << traversal.nodesVisited << " (" << traversal.nodesVisited * perRay << " per ray)" << std::endl;
+	report << "----- Box Tests: " << traversal.boxTests << " (" << traversal.boxTests * perRay << " per ray)" << std::endl;
+	report << "----- Primitive Tests: " << traversal.primitiveTests << " (" << traversal.primitiveTests * perRay << " per ray)" << std::endl;
+	report << "----- Primitive Tests Avoided: " << traversal.primitiveTestsAvoided << " (" << traversal.primitiveTestsAvoided * perRay << " per ray)" << std::endl << std::endl;
+}
+
 void createAllDebugRendersForScene(const SceneMetaData& metaData) {
 	for (int flag = 0; flag != static_cast<int>(Debug::NONE); flag++) {
 		debugFlag = static_cast<Debug>(flag);